@@ -2,6 +2,6 @@
 IFS=$'\n'
 for item in `cat EventNames.txt | tr '\t' ' ' | cut -d ' ' -f2`; do
 	echo -ne "\t\t\t";
-	echo -ne "case ${item}: cout << \"${item}\" << endl; break;\n"
+	echo -ne "case ${item}: return \"${item}\";\n"
 done;
 
@@ -0,0 +1,256 @@
+/*
+* Copyright (c) Jack M. Thompson WebKruncher.com, exexml.com
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the WebKruncher nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY Jack M. Thompson ``AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Jack M. Thompson BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "x11grid.h"
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <new>
+using namespace X11Methods;
+
+static unsigned long long allocations(0);
+void* operator new(size_t size)
+{
+	__sync_add_and_fetch(&allocations,1);
+	void* p(malloc(size?size:1));
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+void operator delete(void* p) throw() { free(p); }
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p,size_t) throw() { free(p); }
+#endif
+
+struct Load
+{
+	Load() : pattern(-1),cells(20000),cards(50),churn(5),atlas(1024) {}
+	int pattern,cells,cards,churn,atlas;
+};
+
+struct Marker : Sprite
+{
+	Marker() : Sprite(16,16,0X0080FF) {}
+	virtual void operator()(Backend& backend,const int x,const int y) const
+	{
+		const short X(x),Y(y);
+		XPoint diamond[5]={{short(X+8),short(Y+1)},{short(X+15),short(Y+8)},{short(X+8),short(Y+15)},{short(X+1),short(Y+8)},{short(X+8),short(Y+1)}};
+		backend.Polygon(0XFF8000,diamond,4);
+		backend.Lines(0XFFFFFF,diamond,5);
+	}
+};
+
+struct Mover : X11Grid::Card
+{
+	Mover(X11Grid::GridBase& _grid,const int _x,const int _y,const int _dx,const int _dy) 
+		: Card(_grid,true),grid(_grid),X(_x),Y(_y),dx(_dx),dy(_dy) { Point p(X,Y); grid[p]+=this; }
+	virtual void cover(Display* display,GC& gc,Pixmap& bitmap,unsigned long color,InvalidBase& invalid,const int x,const int y) 
+	{
+		Batch& batch(grid);
+		batch.Fill(color,x-8,y-8,16,16);
+		invalid.insert(x-8,y-8,x+8,y+8);
+	}
+	virtual void operator()(Pixmap& bitmap,const int x,const int y,Display* display,GC& gc,InvalidBase& invalid)
+	{
+		static const Marker marker;
+		Batch& batch(grid);
+		batch.Stamp(marker,x-8,y-8);
+		invalid.insert(x-8,y-8,x+8,y+8);
+	}
+	virtual Extent bounds(const int x,const int y) const { return Extent(x-8,y-8,x+8,y+8); }
+	void operator()(const int width,const int height)
+	{
+		if ((X+dx<0) || (X+dx>=width)) dx=-dx;
+		if ((Y+dy<0) || (Y+dy>=height)) dy=-dy;
+		grid.move(this,Point(X,Y),Point(X+dx,Y+dy));
+		X+=dx; Y+=dy;
+	}
+	private:
+	X11Grid::GridBase& grid;
+	int X,Y,dx,dy;
+};
+
+template <typename DS>
+	struct Bench : X11Grid::Grid<DS>
+{
+	Bench(GC& _gc,const int _ScreenWidth,const int _ScreenHeight,const Load& _load)
+		: X11Grid::Grid<DS>(NULL,_gc,_ScreenWidth,_ScreenHeight,0X333333),painted(0),load(_load),updateloop(0),oldest(0)
+	{
+		srand(1);
+		Batch& batch(*this);
+		batch.SetAtlas(load.atlas);
+		for (int j=0;j<load.cards;j++)
+			movers.push_back(new Mover(*this,rand()%this->ScreenWidth,rand()%this->ScreenHeight,(rand()%7)-3,(rand()%7)-3));
+		if (load.pattern<0) while (live.size()<(size_t)load.cells) place();
+	}
+	virtual ~Bench() { for (vector<Mover*>::iterator it=movers.begin();it!=movers.end();it++) delete *it; }
+	virtual operator InvalidBase& () { return invalid; }
+	unsigned long long painted;
+	protected:
+	virtual void update()
+	{
+		if (load.pattern>=0) { if (!(updateloop%10)) pattern(); }
+		else for (int j=0;j<(load.cells*load.churn)/100;j++) 
+		{
+			(*this)[live[oldest]].remove();
+			live[oldest]=Point(rand()%this->ScreenWidth,rand()%this->ScreenHeight);
+			(*this)[live[oldest]]=(rand()&0XFFFFFF);
+			oldest=(oldest+1)%live.size();
+		}
+		for (vector<Mover*>::iterator it=movers.begin();it!=movers.end();it++) (**it)(this->ScreenWidth,this->ScreenHeight);
+		DS::RowType::update(updateloop,50);
+		++updateloop;
+	}
+	virtual void operator()(const unsigned long color,Pixmap& bitmap,const int x,const int y)
+	{
+		painted++;
+		X11Grid::Grid<DS>::operator()(color,bitmap,x,y);
+	}
+	virtual void operator()(Pixmap& bitmap,const X11Grid::GridBase::Dot* dots,const int n)
+	{
+		painted+=n;
+		X11Grid::Grid<DS>::operator()(bitmap,dots,n);
+	}
+	private:
+	const Load load;
+	unsigned long updateloop;
+	InvalidArea<Rect,typename DS::Allocation::template Allocator<Rect>::type> invalid;
+	vector<Mover*> movers;
+	vector<Point> live;
+	size_t oldest;
+	void place()
+	{
+		live.push_back(Point(rand()%this->ScreenWidth,rand()%this->ScreenHeight));
+		(*this)[live.back()]=(rand()&0XFFFFFF);
+	}
+	void pattern()
+	{
+		for (vector<Point>::iterator it=live.begin();it!=live.end();it++) (*this)[*it].remove();
+		live.clear();
+		X11Grid::TestPatternGenerator g(this->ScreenWidth,this->ScreenHeight,load.pattern);
+		X11Grid::PatternBase& p(g);
+		const unsigned long color(rand()&0XFFFFFF);
+		for (X11Grid::PatternBase::iterator it=p.begin();it!=p.end();it++)
+		{
+			live.push_back(Point(it->first,it->second));
+			(*this)[live.back()]=color;
+		}
+	}
+};
+
+template <typename DS>
+	double run(ostream& out,const string& structure,const string& workload,const Load& load,const int frames,const int threads,const int width,const int height)
+{
+	FrameBuffer framebuffer(width,height);
+	GC gc(NULL);
+	Bench<DS> grid(gc,width,height,load);
+	Headless attach(grid,framebuffer);
+	attach.SetThreads(threads);
+	Canvas& canvas(grid);
+	InvalidBase& invalid(grid);
+	Pixmap bitmap(0);
+	long long updating(0),rendering(0);
+	unsigned long long updates(0);
+	const unsigned long long before(allocations), pooled(Arena::Allocations());
+	for (int frame=0;frame<frames;frame++)
+	{
+		const long long start(when());
+		const unsigned long long count(allocations);
+		canvas.update();
+		updates+=allocations-count;
+		const long long updated(when());
+		canvas(bitmap);
+		invalid.reduce();
+		invalid.clear();
+		const long long rendered(when());
+		updating+=updated-start;
+		rendering+=rendered-updated;
+	}
+	const unsigned long long allocated(allocations-before), arena(Arena::Allocations()-pooled);
+	struct rusage usage; getrusage(RUSAGE_SELF,&usage);
+	out<<setw(10)<<left<<structure<<setw(12)<<workload<<right
+		<<setw(14)<<(updating/frames)
+		<<setw(14)<<(rendering/frames)
+		<<setw(14)<<(long long)((grid.painted*1e9)/max(rendering,1LL))
+		<<setw(14)<<fixed<<setprecision(1)<<((double)allocated/frames)
+		<<setw(14)<<((double)updates/frames)
+		<<setw(14)<<((double)arena/frames)
+		<<setw(13)<<((double)grid.cards().painted/frames)
+		<<setw(13)<<((double)grid.cards().culled/frames)
+		<<setw(12)<<usage.ru_maxrss<<endl;
+	return (double)allocated/frames;
+}
+
+bool run(ostream& out,const string& structure,const string& workload,const Load& load,const int frames,const int threads,const int width,const int height,const double budget)
+{
+	out.flush();
+	const pid_t pid(fork());
+	if (pid<0) throw runtime_error("Cannot fork");
+	if (pid) { int status(0); waitpid(pid,&status,0); return (WIFEXITED(status)) && (!WEXITSTATUS(status)); }
+	double allocated(0);
+	if (structure=="default") allocated=run<X11Grid::DefaultStructure>(out,structure,workload,load,frames,threads,width,height);
+	if (structure=="pooled") allocated=run<X11Grid::PooledStructure>(out,structure,workload,load,frames,threads,width,height);
+	if (structure=="chunked") allocated=run<X11Grid::ChunkedStructure>(out,structure,workload,load,frames,threads,width,height);
+	if (structure=="packed") allocated=run<X11Grid::PackedStructure>(out,structure,workload,load,frames,threads,width,height);
+	if (structure=="timed") allocated=run<X11Grid::TimedStructure>(out,structure,workload,load,frames,threads,width,height);
+	out.flush();
+	if ((budget>=0) && (allocated>budget)) 
+		{ cerr<<structure<<" "<<workload<<" "<<allocated<<" allocs/frame exceeds "<<budget<<endl; _exit(1); }
+	_exit(0);
+}
+
+int main(int argc,char** argv)
+{
+	X11Grid::CmdLine cmdline(argc,argv,"bench");
+	const int frames(cmdline.exists("-frames")?atoi(cmdline["-frames"].c_str()):300);
+	const int width(cmdline.exists("-width")?atoi(cmdline["-width"].c_str()):1024);
+	const int height(cmdline.exists("-height")?atoi(cmdline["-height"].c_str()):768);
+	const int threads(cmdline.exists("-threads")?atoi(cmdline["-threads"].c_str()):1);
+	Load load;
+	if (cmdline.exists("-cells")) load.cells=atoi(cmdline["-cells"].c_str());
+	if (cmdline.exists("-cards")) load.cards=atoi(cmdline["-cards"].c_str());
+	if (cmdline.exists("-churn")) load.churn=atoi(cmdline["-churn"].c_str());
+	if (cmdline.exists("-atlas")) load.atlas=atoi(cmdline["-atlas"].c_str());
+	const double budget(cmdline.exists("-max-allocs")?atof(cmdline["-max-allocs"].c_str()):-1);
+
+	const char* structures[]={"default","pooled","chunked","packed","timed"};
+	const char* workloads[]={"patternx","circles","sine","synthetic"};
+	ostream& out(cout);
+	out<<setw(10)<<left<<"structure"<<setw(12)<<"workload"<<right
+		<<setw(14)<<"update-ns"<<setw(14)<<"render-ns"<<setw(14)<<"cells/sec"<<setw(14)<<"allocs/frame"<<setw(14)<<"update-allocs"<<setw(14)<<"pooled/frame"<<setw(13)<<"cards/frame"<<setw(13)<<"culled/frame"<<setw(12)<<"peak-rss-kb"<<endl;
+	bool passed(true);
+	for (int s=0;s<5;s++)
+	{
+		if ((cmdline.exists("-structure")) && (cmdline["-structure"]!=structures[s])) continue;
+		for (int w=0;w<4;w++)
+		{
+			if ((cmdline.exists("-workload")) && (cmdline["-workload"]!=workloads[w])) continue;
+			Load l(load);
+			l.pattern=(w<3)?w:-1;
+			if (!run(out,structures[s],workloads[w],l,frames,threads,width,height,budget)) passed=false;
+		}
+	}
+	return passed?0:1;
+}
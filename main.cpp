@@ -39,6 +39,7 @@ struct TestStructure : X11Grid::DefaultStructure
 		typedef CustomRow RowType;
 		typedef CustomColumn ColumnType;
 		typedef CustomCell CellType;
+		typedef X11Grid::ArenaAllocation Allocation;
 };
 
 	struct TestRect : X11Methods::Rect
@@ -47,29 +48,15 @@ struct TestStructure : X11Grid::DefaultStructure
 		TestRect(const int ulx,const int uly,const int brx,const int bry) 
 			: Rect(ulx,uly,brx,bry) {}
 		TestRect(const TestRect& a) : X11Methods::Rect(a) {}
-		TestRect& operator=(const TestRect& a) { X11Methods::Rect::operator=(a); }
-		virtual operator XPoint& () 
-		{
-			if (xpoints) delete[] xpoints;
-			xpoints=new XPoint[4];	
-			xpoints[0].x=first.first;
-			xpoints[0].y=first.second;
-			xpoints[1].x=second.first;
-			xpoints[1].y=first.second;
-			xpoints[2].x=second.first;
-			xpoints[2].y=second.second;
-			xpoints[3].x=first.first;
-			xpoints[3].y=second.second;
-			return *xpoints;
-		}
+		TestRect& operator=(const TestRect& a) { X11Methods::Rect::operator=(a); return *this; }
 	};
 
-struct CustomCell : X11Grid::Cell
+struct CustomCell : X11Grid::Cell<TestStructure>
 {
 		CustomCell(X11Grid::GridBase& _grid,const int _x,const int _y,unsigned long background)
-			: X11Grid::Cell(_grid,_x,_y,background) {}
+			: X11Grid::Cell<TestStructure>(_grid,_x,_y,background) {}
 		virtual void operator()(Pixmap& bitmap)
-			{ X11Grid::Cell::operator()(bitmap); }
+			{ X11Grid::Cell<TestStructure>::operator()(bitmap); }
 };
 
 struct CustomColumn : X11Grid::Column<TestStructure>
@@ -88,42 +75,47 @@ struct CustomRow : X11Grid::Row<TestStructure>
 
 struct Bubble : X11Grid::Card
 {
-	Bubble(X11Grid::GridBase& _grid,string _text) : grid(_grid), Card(_grid), text(_text) {}
+	Bubble(X11Grid::GridBase& _grid,string _text) : grid(_grid), Card(_grid,true), reach(50), X(0), Y(0) { (*this)=_text; }
 	virtual void cover(Display* display,GC& gc,Pixmap& bitmap,unsigned long color,X11Methods::InvalidBase& _invalid,const int X,const int Y) 
 	{
-		TestRect r(X-50,Y-20,X+50,Y+20);	
-		XPoint& points(r);
-		XSetForeground(display,gc,color);
-		XFillPolygon(display,bitmap,  gc,&points, 4, Complex, CoordModeOrigin);
+		TestRect r(X-50,Y-20,X+reach,Y+20);	
+		X11Methods::Batch& batch(grid);
+		batch.Fill(color,X-50,Y-20,50+reach,40);
 		InvalidArea<TestRect>& invalid(static_cast<InvalidArea<TestRect>&>(_invalid));
 		invalid.insert(r);
 	}
 
 	virtual void operator()(Pixmap& bitmap,const int x,const int y,Display* display,GC& gc,X11Methods::InvalidBase& _invalid)
 	{
-		TestRect r(X-50,Y-20,X+50,Y+20);	
-		XPoint& points(r);
-		XSetForeground(display,gc,0X0080FF);
-		XFillPolygon(display,bitmap,  gc,&points, 4, Complex, CoordModeOrigin);
-		XSetForeground(display,gc,0X8800FF);
-		stringstream ss; ss<<id<<") "<<text;
-		XDrawString(display,bitmap,gc,X-40,Y,ss.str().c_str(),ss.str().size());
+		TestRect r(X-50,Y-20,X+reach,Y+20);	
+		X11Methods::Batch& batch(grid);
+		batch.Fill(0X0080FF,X-50,Y-20,50+reach,40);
+		batch.Label(0X8800FF,0X0080FF,X-40,Y,caption);
 		InvalidArea<TestRect>& invalid(static_cast<InvalidArea<TestRect>&>(_invalid));
 		invalid.insert(r);
 	}
 	void operator()(int x,int y)
 	{
-		Point b(X,Y);
-		grid[b]-=this;
-		Point p(x,y);
-		grid[p]+=this;
+		grid.move(this,Point(X,Y),Point(x,y));
 		X=x; Y=y;
 	}
-	void operator = ( const string t ) { text=t; }
+	virtual X11Methods::Extent bounds(const int x,const int y) const { return X11Methods::Extent(x-50,y-20,x+reach,y+20); }
+	virtual bool move(const int x,const int y) { (*this)(x,y); return true; }
+	void operator = ( const string t ) 
+	{ 
+		if ((t==text) && (!caption.empty())) return;
+		text=t; 
+		stringstream ss; ss<<id<<") "<<text;
+		caption=ss.str();
+		const int wider(static_cast<int>(caption.size()*6)-40);
+		if (wider<=reach) return;
+		reach=wider;
+		grid.reshape(this,X,Y);
+	}
 	private:
 	X11Grid::GridBase& grid;
-	string text;
-	int X,Y;
+	string text,caption;
+	int reach,X,Y;
 };
 
 struct ColorCurve
@@ -197,7 +189,11 @@ struct TestPattern : X11Grid::Grid<TestStructure>
 	ColorCurve curve;
 	void operator()(Pixmap& bitmap) 
 	{ 
-		//paint.clear();
+		batch.Fill(0X2222,10,100,ScreenWidth-160,40);
+		X11Grid::Grid<TestStructure>::operator()(bitmap);
+	}
+	void status()
+	{
 		stringstream ss;
 		stringstream ssupdates; ssupdates<<"Update:"<<updateloop;
 		stringstream pingpong,sscolor; 
@@ -210,11 +206,6 @@ struct TestPattern : X11Grid::Grid<TestStructure>
 		ss<<setw(40)<<left<<sscolor.str();
 		ss<<(*this);
 		Root=ss.str();
-		XSetForeground(display,gc,0X2222);
-		XFillRectangle(display,bitmap,gc,10,100,ScreenWidth-160,40);
-		XSetForeground(display,gc,0X7F7F7F);
-		//XDrawString(display,bitmap,gc,20,120,ss.str().c_str(),ss.str().size());
-		X11Grid::Grid<TestStructure>::operator()(bitmap);
 	}
 	bool side,dir,flip; const int limit,step;
 	pair<int,int> ping,pong;
@@ -251,6 +242,7 @@ struct TestPattern : X11Grid::Grid<TestStructure>
 		}
 #endif
 		TestStructure::RowType::update(updateloop,50);
+		if (!(updateloop%10)) status();
 		++updateloop;
 	}
 	private:
@@ -263,9 +255,7 @@ struct TestPattern : X11Grid::Grid<TestStructure>
 	{
 #if 0
 		TestRect r(x-2,y-2,x+2,y+2);	
-		XPoint& points(r);
-		XSetForeground(display,gc,color);
-		XFillPolygon(display,bitmap,  gc,&points, 4, Complex, CoordModeOrigin);
+		batch.Fill(color,x-2,y-2,4,4);
 		InvalidBase& _invalidbase(*this);
 		InvalidArea<TestRect>& invalid(static_cast<InvalidArea<TestRect>&>(_invalidbase));
 		invalid.insert(r);
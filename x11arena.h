@@ -0,0 +1,158 @@
+/*
+* Copyright (c) Jack M. Thompson WebKruncher.com, exexml.com
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the WebKruncher nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY Jack M. Thompson ``AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Jack M. Thompson BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef __X11_ARENA_H__
+#define __X11_ARENA_H__
+#include <memory>
+#include <new>
+
+namespace X11Methods
+{
+	using namespace std;
+
+	struct Arena
+	{
+		enum {Largest=1024,Slab=65536};
+		static volatile unsigned long long& Allocations() { static volatile unsigned long long n(0); return n; }
+		static volatile unsigned long long& Slabs() { static volatile unsigned long long n(0); return n; }
+	};
+
+	// one free list per block size, shared by all threads: a block freed by a
+	// pool worker goes back to the same list the main thread allocates from.
+	// each thread keeps a cache in front of it and only takes the lock to move
+	// a batch of blocks between its cache and the shared list
+	template <size_t Size>
+		struct FixedArena
+	{
+		enum {Block=((Size+15)/16)*16,Batch=64};
+		static void* allocate()
+		{
+			__sync_add_and_fetch(&Arena::Allocations(),1);
+			if (!cache) refill();
+			void* p(cache); 
+			cache=*static_cast<void**>(p); 
+			cached--;
+			return p;
+		}
+		static void deallocate(void* p) 
+		{ 
+			*static_cast<void**>(p)=cache; 
+			cache=p; 
+			if (++cached>=2*Batch) drain();
+		}
+		private:
+		static void refill()
+		{
+			Guard guard(spin);
+			while ((head) && (cached<Batch))
+			{
+				void* p(head); 
+				head=*static_cast<void**>(p); 
+				*static_cast<void**>(p)=cache; 
+				cache=p; 
+				cached++;
+			}
+			if (cache) return;
+			if ((!cursor) || (cursor+Block>limit))
+			{
+				cursor=static_cast<char*>(::operator new(Arena::Slab));
+				limit=cursor+Arena::Slab;
+				__sync_add_and_fetch(&Arena::Slabs(),1);
+			}
+			for (;(cached<Batch) && (cursor+Block<=limit);cursor+=Block,cached++) 
+				{ *reinterpret_cast<void**>(cursor)=cache; cache=cursor; }
+		}
+		static void drain()
+		{
+			void* first(cache);
+			void* last(cache);
+			for (int i=1;i<Batch;i++) last=*static_cast<void**>(last);
+			cache=*static_cast<void**>(last);
+			cached-=Batch;
+			Guard guard(spin);
+			*static_cast<void**>(last)=head; 
+			head=first;
+		}
+		static SpinLock spin;
+		static void* head;
+		static char* cursor;
+		static char* limit;
+		static __thread void* cache;
+		static __thread int cached;
+	};
+	template <size_t Size> SpinLock FixedArena<Size>::spin;
+	template <size_t Size> void* FixedArena<Size>::head(NULL);
+	template <size_t Size> char* FixedArena<Size>::cursor(NULL);
+	template <size_t Size> char* FixedArena<Size>::limit(NULL);
+	template <size_t Size> __thread void* FixedArena<Size>::cache(NULL);
+	template <size_t Size> __thread int FixedArena<Size>::cached(0);
+
+	template <typename T>
+		struct ArenaAllocator
+	{
+		typedef T value_type;
+		typedef T* pointer;
+		typedef const T* const_pointer;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef size_t size_type;
+		typedef ptrdiff_t difference_type;
+		template <typename U> struct rebind { typedef ArenaAllocator<U> other; };
+		ArenaAllocator() {}
+		ArenaAllocator(const ArenaAllocator&) {}
+		template <typename U> ArenaAllocator(const ArenaAllocator<U>&) {}
+		pointer address(reference r) const { return &r; }
+		const_pointer address(const_reference r) const { return &r; }
+		pointer allocate(const size_type n,const void* =0)
+		{
+			if ((n==1) && (sizeof(T)<=Arena::Largest)) return static_cast<pointer>(FixedArena<sizeof(T)>::allocate());
+			return static_cast<pointer>(::operator new(n*sizeof(T)));
+		}
+		void deallocate(pointer p,const size_type n)
+		{
+			if ((n==1) && (sizeof(T)<=Arena::Largest)) FixedArena<sizeof(T)>::deallocate(p);
+			else ::operator delete(p);
+		}
+		size_type max_size() const { return static_cast<size_type>(-1)/sizeof(T); }
+		void construct(pointer p,const T& t) { new (p) T(t); }
+		void destroy(pointer p) { p->~T(); }
+	};
+	template <typename T,typename U> 
+		inline bool operator==(const ArenaAllocator<T>&,const ArenaAllocator<U>&) { return true; }
+	template <typename T,typename U> 
+		inline bool operator!=(const ArenaAllocator<T>&,const ArenaAllocator<U>&) { return false; }
+
+	struct StandardAllocation
+	{
+		template <typename T> struct Allocator { typedef allocator<T> type; };
+	};
+
+	struct ArenaAllocation
+	{
+		template <typename T> struct Allocator { typedef ArenaAllocator<T> type; };
+	};
+} //X11Methods
+#endif //__X11_ARENA_H__
@@ -0,0 +1,142 @@
+/*
+* Copyright (c) Jack M. Thompson WebKruncher.com, exexml.com
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the WebKruncher nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY Jack M. Thompson ``AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Jack M. Thompson BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef __X11_ATLAS_H__
+#define __X11_ATLAS_H__
+
+namespace X11Methods
+{
+	using namespace std;
+
+	struct Sprite
+	{
+		Sprite(const int _width,const int _height,const unsigned long _background) 
+			: id(Next()),width(_width),height(_height),background(_background) {}
+		virtual ~Sprite() {}
+		virtual void operator()(Backend& backend,const int x,const int y) const = 0;
+		void Draw(Backend& backend,const int x,const int y) const
+		{
+			XRectangle r; r.x=x; r.y=y; r.width=width; r.height=height;
+			backend.Fill(background,&r,1);
+			(*this)(backend,x,y);
+		}
+		const unsigned long long id;
+		const int width,height;
+		const unsigned long background;
+		private:
+		static unsigned long long Next() { static volatile unsigned long long next(0); return __sync_add_and_fetch(&next,1); }
+	};
+
+	struct Shelves
+	{
+		Shelves(const int _size) : size(_size),top(0) {}
+		bool operator()(const int w,const int h,pair<int,int>& at)
+		{
+			if ((w>size) || (h>size)) return false;
+			Shelf* best(NULL);
+			for (vector<Shelf>::iterator it=shelves.begin();it!=shelves.end();it++)
+				if ((h<=it->height) && (it->used+w<=size) && ((!best) || (it->height<best->height))) best=&(*it);
+			if (!best)
+			{
+				if (top+h>size) return false;
+				shelves.push_back(Shelf(top,h));
+				top+=h;
+				best=&shelves.back();
+			}
+			at=make_pair(best->used,best->y);
+			best->used+=w;
+			return true;
+		}
+		void clear() { shelves.clear(); top=0; }
+		int Size() const { return size; }
+		void SetSize(const int n) { size=n; clear(); }
+		private:
+		struct Shelf
+		{
+			Shelf(const int _y,const int _height) : y(_y),height(_height),used(0) {}
+			int y,height,used;
+		};
+		int size,top;
+		vector<Shelf> shelves;
+	};
+
+	struct Atlas
+	{
+		Atlas(const int size) : shelves(size) {}
+		virtual ~Atlas() {}
+		int Size() const { return shelves.Size(); }
+		size_t Count() const { return placed.size(); }
+		protected:
+		Shelves shelves;
+		map<unsigned long long,pair<int,int> > placed;
+		bool locate(const Sprite& sprite,pair<int,int>& at)
+		{
+			map<unsigned long long,pair<int,int> >::iterator found(placed.find(sprite.id));
+			if (found!=placed.end()) { at=found->second; return true; }
+			if (!shelves(sprite.width,sprite.height,at))
+			{
+				// full sheet: start over, whatever is still in use is placed again on demand
+				if ((sprite.width>Size()) || (sprite.height>Size())) return false;
+				placed.clear(); shelves.clear();
+				if (!shelves(sprite.width,sprite.height,at)) return false;
+			}
+			placed[sprite.id]=at;
+			render(sprite,at);
+			return true;
+		}
+		virtual void render(const Sprite&,const pair<int,int>&) = 0;
+	};
+
+	struct RasterAtlas : Atlas
+	{
+		RasterAtlas(const int size=1024) : Atlas(size),sheet(NULL) {}
+		virtual ~RasterAtlas() { if (sheet) delete sheet; }
+		void SetSize(const int n) { if (sheet) delete sheet; sheet=NULL; placed.clear(); shelves.SetSize(n); }
+		void operator()(Backend& target,const Sprite& sprite,const pair<int,int>* at,const int n)
+		{
+			pair<int,int> p;
+			if (!locate(sprite,p))
+			{
+				for (int i=0;i<n;i++) sprite.Draw(target,at[i].first,at[i].second);
+				return;
+			}
+			for (int i=0;i<n;i++)
+				target.Copy(*sheet,p.first,p.second,sprite.width,sprite.height,at[i].first,at[i].second);
+		}
+		protected:
+		virtual void render(const Sprite& sprite,const pair<int,int>& at)
+		{
+			if (!sheet) sheet=new FrameBuffer(Size(),Size());
+			Raster view((*sheet)(at.first,at.second,at.first+sprite.width,at.second+sprite.height));
+			sprite.Draw(view,at.first,at.second);
+		}
+		private:
+		FrameBuffer* sheet;
+		RasterAtlas(const RasterAtlas&);
+		void operator=(const RasterAtlas&);
+	};
+} //X11Methods
+#endif //__X11_ATLAS_H__
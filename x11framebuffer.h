@@ -0,0 +1,409 @@
+/*
+* Copyright (c) Jack M. Thompson WebKruncher.com, exexml.com
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the WebKruncher nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY Jack M. Thompson ``AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Jack M. Thompson BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef __X11_FRAMEBUFFER_H__
+#define __X11_FRAMEBUFFER_H__
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+namespace X11Methods
+{
+	using namespace std;
+
+	struct Backend
+	{
+		virtual ~Backend() {}
+		virtual void Fill(const unsigned long color,XRectangle* rects,const int n) = 0;
+		virtual void Polygon(const unsigned long color,XPoint* points,const int n) = 0;
+		virtual void Lines(const unsigned long color,XPoint* points,const int n) = 0;
+		virtual void Segments(const unsigned long color,XSegment* segments,const int n) = 0;
+		virtual void Text(const unsigned long color,const int x,const int y,const string& text) = 0;
+		virtual void Copy(Backend& source,const int sx,const int sy,const int w,const int h,const int dx,const int dy) = 0;
+	};
+
+	class Raster : public Backend
+	{
+		public:
+		Raster(unsigned int* _pixels,const int _stride,const int _x1,const int _y1,const int _x2,const int _y2)
+			: pixels(_pixels),stride(_stride),x1(_x1),y1(_y1),x2(_x2),y2(_y2) {}
+		unsigned int* operator[](const int y) { return pixels+(y*stride); }
+		Raster operator()(const int ulx,const int uly,const int brx,const int bry)
+			{ return Raster(pixels,stride,max(ulx,x1),max(uly,y1),min(brx,x2),min(bry,y2)); }
+		void Fill(const unsigned long color,int x,int y,int w,int h)
+		{
+			if (!clip(x,y,w,h)) return;
+			for (int j=y;j<y+h;j++) 
+			{ 
+				unsigned int* row((*this)[j]+x); 
+				for (int i=0;i<w;i++) row[i]=color; 
+			}
+		}
+		virtual void Fill(const unsigned long color,XRectangle* rects,const int n)
+			{ for (int i=0;i<n;i++) Fill(color,rects[i].x,rects[i].y,rects[i].width,rects[i].height); }
+		virtual void Polygon(const unsigned long color,XPoint* points,const int n)
+		{
+			if (n<3) return;
+			int top(points[0].y), bottom(points[0].y), left(points[0].x), right(points[0].x);
+			for (int i=1;i<n;i++) 
+			{ 
+				top=min(top,(int)points[i].y); bottom=max(bottom,(int)points[i].y); 
+				left=min(left,(int)points[i].x); right=max(right,(int)points[i].x); 
+			}
+			vector<int> crossings;
+			for (int y=max(top,y1);y<min(bottom,y2);y++)
+			{
+				crossings.clear();
+				for (int i=0;i<n;i++)
+				{
+					const XPoint& a(points[i]);
+					const XPoint& b(points[(i+1)%n]);
+					if ((a.y<=y)==(b.y<=y)) continue;
+					crossings.push_back(a.x+(((y-a.y)*(b.x-a.x))/(b.y-a.y)));
+				}
+				sort(crossings.begin(),crossings.end());
+				for (size_t i=0;i+1<crossings.size();i+=2) span(color,crossings[i],crossings[i+1],y);
+			}
+		}
+		virtual void Lines(const unsigned long color,XPoint* points,const int n)
+			{ for (int i=0;i+1<n;i++) line(color,points[i].x,points[i].y,points[i+1].x,points[i+1].y); }
+		virtual void Segments(const unsigned long color,XSegment* segments,const int n)
+			{ for (int i=0;i<n;i++) line(color,segments[i].x1,segments[i].y1,segments[i].x2,segments[i].y2); }
+		virtual void Text(const unsigned long color,const int x,const int y,const string& text)
+		{
+			for (size_t i=0;i<text.size();i++)
+				if (text[i]!=' ') Fill(color,x+(i*6)+1,y-8,4,8);
+		}
+		virtual void Copy(Backend& _source,const int sx,const int sy,const int w,const int h,const int dx,const int dy)
+		{
+			Raster& source(dynamic_cast<Raster&>(_source));
+			int x(dx),y(dy),cw(w),ch(h);
+			if (!clip(x,y,cw,ch)) return;
+			const int ox(sx+(x-dx)), oy(sy+(y-dy));
+			if ((ox<source.x1) || (oy<source.y1) || (ox+cw>source.x2) || (oy+ch>source.y2)) return;
+			if ((source.pixels==pixels) && (oy<y))
+				for (int j=ch-1;j>=0;j--) memmove((*this)[y+j]+x,source[oy+j]+ox,cw*sizeof(unsigned int));
+			else 
+				for (int j=0;j<ch;j++) memmove((*this)[y+j]+x,source[oy+j]+ox,cw*sizeof(unsigned int));
+		}
+		protected:
+		unsigned int* pixels;
+		int stride;
+		int x1,y1,x2,y2;
+		void span(const unsigned long color,int xa,int xb,const int y)
+		{
+			if (xa<x1) xa=x1;
+			if (xb>x2) xb=x2;
+			unsigned int* row((*this)[y]);
+			for (int x=xa;x<xb;x++) row[x]=color;
+		}
+		void line(const unsigned long color,int xa,int ya,const int xb,const int yb)
+		{
+			const int dx(abs(xb-xa)), dy(-abs(yb-ya)), sx((xa<xb)?1:-1), sy((ya<yb)?1:-1);
+			int error(dx+dy);
+			while (true)
+			{
+				if ((xa>=x1) && (ya>=y1) && (xa<x2) && (ya<y2)) (*this)[ya][xa]=color;
+				if ((xa==xb) && (ya==yb)) break;
+				const int e2(2*error);
+				if (e2>=dy) { error+=dy; xa+=sx; }
+				if (e2<=dx) { error+=dx; ya+=sy; }
+			}
+		}
+		bool clip(int& x,int& y,int& w,int& h) const
+		{
+			if (x<x1) { w-=x1-x; x=x1; }
+			if (y<y1) { h-=y1-y; y=y1; }
+			if (x+w>x2) w=x2-x;
+			if (y+h>y2) h=y2-y;
+			return ((w>0) && (h>0));
+		}
+	};
+
+	class FrameBuffer : public Raster
+	{
+		public:
+		FrameBuffer(Display* _display,const int _width,const int _height,const unsigned long background=0)
+			: Raster(NULL,0,0,0,_width,_height),display(_display),width(_width),height(_height),image(NULL),attached(false),forwarded(false),putting(false),completion(-1),drawable(0)
+		{
+			memset(&shminfo,0,sizeof(shminfo)); 
+			shminfo.shmid=-1;
+			if (!XShmQueryExtension(display)) return;
+			completion=XShmGetEventBase(display)+ShmCompletion;
+			const int screen(DefaultScreen(display));
+			image=XShmCreateImage(display,DefaultVisual(display,screen),DefaultDepth(display,screen),ZPixmap,NULL,&shminfo,width,height);
+			if (!image) return;
+			if (image->bits_per_pixel!=32) { release(); return; }
+			shminfo.shmid=shmget(IPC_PRIVATE,image->bytes_per_line*image->height,IPC_CREAT|0600);
+			if (shminfo.shmid<0) { release(); return; }
+			char* shared(static_cast<char*>(shmat(shminfo.shmid,NULL,0)));
+			if (shared==reinterpret_cast<char*>(-1)) { release(); return; }
+			shminfo.shmaddr=image->data=shared;
+			shminfo.readOnly=False;
+			if (!attach()) { release(); return; }
+			pixels=reinterpret_cast<unsigned int*>(image->data);
+			stride=image->bytes_per_line/sizeof(unsigned int);
+			// the pixmap already holds the background; nothing is put until it is drawn over
+			for (int y=0;y<height;y++) 
+			{ 
+				unsigned int* row((*this)[y]); 
+				for (int x=0;x<width;x++) row[x]=background; 
+			}
+		}
+		FrameBuffer(const int _width,const int _height)
+			: Raster(new unsigned int[_width*_height],_width,0,0,_width,_height),display(NULL),width(_width),height(_height),image(NULL),attached(false),forwarded(false),putting(false),completion(-1),drawable(0)
+		{
+			memset(&shminfo,0,sizeof(shminfo)); 
+			shminfo.shmid=-1;
+			memset(pixels,0,sizeof(unsigned int)*width*height);
+		}
+		virtual ~FrameBuffer() { release(); }
+		operator bool () const { return pixels!=NULL; }
+		bool Shared() const { return image!=NULL; }
+		int Width() const { return width; }
+		int Height() const { return height; }
+		void Dump(ostream& o,const bool raw=false)
+		{
+			if (raw) 
+			{
+				for (int y=0;y<height;y++) o.write(reinterpret_cast<const char*>((*this)[y]),width*sizeof(unsigned int));
+				return;
+			}
+			o<<"P6\n"<<width<<" "<<height<<"\n255\n";
+			vector<unsigned char> line(width*3);
+			for (int y=0;y<height;y++)
+			{
+				const unsigned int* row((*this)[y]);
+				for (int x=0;x<width;x++)
+				{
+					line[(x*3)]=(row[x]>>16)&0XFF;
+					line[(x*3)+1]=(row[x]>>8)&0XFF;
+					line[(x*3)+2]=row[x]&0XFF;
+				}
+				o.write(reinterpret_cast<const char*>(&line[0]),line.size());
+			}
+		}
+		void Put(Drawable bitmap,GC& gc)
+		{
+			if (!image) return;
+			drawable=bitmap; putting=true;
+			XShmPutImage(display,bitmap,gc,image,0,0,0,0,width,height,True);
+		}
+		// only the rects the grid invalidated go out; the last one asks the server for a completion event
+		void Put(Drawable bitmap,GC& gc,const vector<XRectangle>& rects)
+		{
+			if (!image) return;
+			damaged.clear();
+			for (vector<XRectangle>::const_iterator it=rects.begin();it!=rects.end();it++)
+			{
+				int x(it->x),y(it->y),w(it->width),h(it->height);
+				if (!clip(x,y,w,h)) continue;
+				XRectangle r; r.x=x; r.y=y; r.width=w; r.height=h;
+				damaged.push_back(r);
+			}
+			if (damaged.empty()) return;
+			// set before the request goes out, since another thread may read the completion
+			drawable=bitmap; putting=true;
+			for (size_t i=0;i<damaged.size();i++)
+			{
+				const XRectangle& r(damaged[i]);
+				XShmPutImage(display,bitmap,gc,image,r.x,r.y,r.x,r.y,r.width,r.height,(i+1==damaged.size())?True:False);
+			}
+		}
+		// the server reads the segment after XShmPutImage returns, and is done once the completion comes back
+		void Wait()
+		{
+			if (!putting) return;
+			if (forwarded) { while (putting) usleep(100); return; }
+			XEvent e;
+			XIfEvent(display,&e,Completion,reinterpret_cast<XPointer>(this));
+			putting=false;
+		}
+		// whoever reads the event queue hands completions back here
+		bool Completed(const XEvent& e)
+		{
+			if ((!putting) || (!completes(e))) return false;
+			putting=false;
+			return true;
+		}
+		void SetForwarded(const bool f) { forwarded=f; }
+		private:
+		Display* display;
+		const int width,height;
+		XImage* image;
+		XShmSegmentInfo shminfo;
+		bool attached,forwarded;
+		volatile bool putting;
+		int completion;
+		Drawable drawable;
+		vector<XRectangle> damaged;
+		bool completes(const XEvent& e) const
+			{ return (e.type==completion) && (reinterpret_cast<const XShmCompletionEvent&>(e).drawable==drawable); }
+		static Bool Completion(Display*,XEvent* e,XPointer self) { return reinterpret_cast<FrameBuffer*>(self)->completes(*e); }
+		static bool& failed() { static bool f(false); return f; }
+		static int trap(Display*,XErrorEvent*) { failed()=true; return 0; }
+		bool attach()
+		{
+			XSync(display,False);
+			failed()=false;
+			XErrorHandler previous(XSetErrorHandler(trap));
+			XShmAttach(display,&shminfo);
+			XSync(display,False);
+			XSetErrorHandler(previous);
+			if (failed()) return false;
+			attached=true;
+			shmctl(shminfo.shmid,IPC_RMID,NULL);
+			return true;
+		}
+		void release()
+		{
+			Wait();
+			if (attached) XShmDetach(display,&shminfo);
+			attached=false;
+			if (image) { image->data=NULL; XDestroyImage(image); image=NULL; }
+			if (shminfo.shmaddr) shmdt(shminfo.shmaddr);
+			if (shminfo.shmid>=0) shmctl(shminfo.shmid,IPC_RMID,NULL);
+			shminfo.shmaddr=NULL; shminfo.shmid=-1;
+			if ((pixels) && (!display)) delete[] pixels;
+			pixels=NULL;
+		}
+		FrameBuffer(const FrameBuffer&);
+		void operator=(const FrameBuffer&);
+	};
+	class Tiler : public Backend, public Job
+	{
+		public:
+		enum {TileBits=8,Tile=(1<<TileBits)};
+		Tiler(FrameBuffer& _framebuffer,Pool& _pool) 
+			: framebuffer(_framebuffer),pool(_pool),
+				columns((_framebuffer.Width()+Tile-1)>>TileBits),rows((_framebuffer.Height()+Tile-1)>>TileBits),bins(columns*rows) {}
+		bool operator()(FrameBuffer& f,Pool& p) const { return (&f==&framebuffer) && (&p==&pool); }
+		void Fill(const unsigned long color,const int x,const int y,const int w,const int h)
+		{
+			XRectangle r; r.x=x; r.y=y; r.width=w; r.height=h;
+			rects.push_back(r);
+			push(Command(FillCommand,color,rects.size()-1,1),x,y,w,h);
+		}
+		virtual void Fill(const unsigned long color,XRectangle* r,const int n)
+			{ for (int i=0;i<n;i++) Fill(color,r[i].x,r[i].y,r[i].width,r[i].height); }
+		virtual void Polygon(const unsigned long color,XPoint* p,const int n) { shape(PolygonCommand,color,p,n); }
+		virtual void Lines(const unsigned long color,XPoint* p,const int n) { shape(LinesCommand,color,p,n); }
+		virtual void Segments(const unsigned long color,XSegment* s,const int n)
+		{
+			for (int i=0;i<n;i++)
+			{
+				segments.push_back(s[i]);
+				const int x(min(s[i].x1,s[i].x2)), y(min(s[i].y1,s[i].y2));
+				push(Command(SegmentsCommand,color,segments.size()-1,1),x,y,abs(s[i].x2-s[i].x1)+1,abs(s[i].y2-s[i].y1)+1);
+			}
+		}
+		virtual void Text(const unsigned long color,const int x,const int y,const string& text)
+		{
+			texts.push_back(Placed(make_pair(x,y),text));
+			push(Command(TextCommand,color,texts.size()-1,1),x,y-8,text.size()*6,8);
+		}
+		virtual void Copy(Backend& source,const int sx,const int sy,const int w,const int h,const int dx,const int dy)
+		{
+			(*this)();
+			framebuffer.Copy(source,sx,sy,w,h,dx,dy);
+		}
+		void operator()()
+		{
+			if (commands.empty()) return;
+			pool(*this,bins.size());
+			for (vector<vector<int> >::iterator it=bins.begin();it!=bins.end();it++) it->clear();
+			commands.clear(); rects.clear(); points.clear(); segments.clear(); texts.clear();
+		}
+		virtual void operator()(const int i)
+		{
+			const vector<int>& bin(bins[i]);
+			if (bin.empty()) return;
+			const int x((i%columns)<<TileBits), y((i/columns)<<TileBits);
+			Raster tile(framebuffer(x,y,x+Tile,y+Tile));
+			for (vector<int>::const_iterator it=bin.begin();it!=bin.end();it++)
+			{
+				const Command& c(commands[*it]);
+				switch (c.type)
+				{
+					case FillCommand: tile.Fill(c.color,&rects[c.first],c.count); break;
+					case PolygonCommand: tile.Polygon(c.color,&points[c.first],c.count); break;
+					case LinesCommand: tile.Lines(c.color,&points[c.first],c.count); break;
+					case SegmentsCommand: tile.Segments(c.color,&segments[c.first],c.count); break;
+					case TextCommand: tile.Text(c.color,texts[c.first].first.first,texts[c.first].first.second,texts[c.first].second); break;
+				}
+			}
+		}
+		private:
+		enum {FillCommand,PolygonCommand,LinesCommand,SegmentsCommand,TextCommand};
+		struct Command
+		{
+			Command(const int _type,const unsigned long _color,const int _first,const int _count) 
+				: type(_type),color(_color),first(_first),count(_count) {}
+			int type;
+			unsigned long color;
+			int first,count;
+		};
+		typedef pair<pair<int,int>,string> Placed;
+		FrameBuffer& framebuffer;
+		Pool& pool;
+		const int columns,rows;
+		vector<vector<int> > bins;
+		vector<Command> commands;
+		vector<XRectangle> rects;
+		vector<XPoint> points;
+		vector<XSegment> segments;
+		vector<Placed> texts;
+		void shape(const int type,const unsigned long color,XPoint* p,const int n)
+		{
+			if (n<1) return;
+			const int first(points.size());
+			int ulx(p[0].x),uly(p[0].y),brx(p[0].x),bry(p[0].y);
+			for (int i=0;i<n;i++)
+			{
+				points.push_back(p[i]);
+				ulx=min(ulx,(int)p[i].x); uly=min(uly,(int)p[i].y);
+				brx=max(brx,(int)p[i].x); bry=max(bry,(int)p[i].y);
+			}
+			push(Command(type,color,first,n),ulx,uly,brx-ulx+1,bry-uly+1);
+		}
+		void push(const Command& command,int x,int y,int w,int h)
+		{
+			if (x<0) { w+=x; x=0; }
+			if (y<0) { h+=y; y=0; }
+			if (x+w>framebuffer.Width()) w=framebuffer.Width()-x;
+			if (y+h>framebuffer.Height()) h=framebuffer.Height()-y;
+			if ((w<=0) || (h<=0)) return;
+			const int index(commands.size());
+			commands.push_back(command);
+			for (int ty=(y>>TileBits);ty<=((y+h-1)>>TileBits);ty++)
+				for (int tx=(x>>TileBits);tx<=((x+w-1)>>TileBits);tx++) 
+					bins[(ty*columns)+tx].push_back(index);
+		}
+		Tiler(const Tiler&);
+		void operator=(const Tiler&);
+	};
+} //X11Methods
+#endif //__X11_FRAMEBUFFER_H__
@@ -69,7 +69,6 @@ struct Sine : PatternBase
 	private: Sine(){}
 	virtual void operator ()(const int w,const int h) 
 	{
-		const double cx(w/2);
 		for (int cy=0;cy<h;cy+=(h/5))
 		{
 			double n(0);
@@ -86,12 +85,16 @@ struct Sine : PatternBase
 
 PatternBase* PatternBase::generate(const int w,const int h)
 {
-	PatternBase* p(NULL);
 	#if 1
-		const int r(rand()%NPATTERNS);
+		return generate(w,h,rand()%NPATTERNS);
 	#else
-		const int r(NPATTERNS-1);
+		return generate(w,h,NPATTERNS-1);
 	#endif
+}
+
+PatternBase* PatternBase::generate(const int w,const int h,const int r)
+{
+	PatternBase* p(NULL);
 	switch(r)
 	{
 		case 0:p=new PatternX; break;
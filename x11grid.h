@@ -32,18 +32,40 @@
 
 #include <vector>
 #include <stdexcept>
-#include <iomanip.h>
+#include <iomanip>
 #include <string>
 #include <sstream>
 #include <map>
 #include <set>
 #include <iostream>
 #include <deque>
+#include <fstream>
 #include <utility>
+#include <algorithm>
+#include <cstring>
+#include <climits>
+#include <tr1/unordered_map>
+#if __cplusplus>=201103L
+#include <tuple>
+#endif
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
 #include <X11/Xatom.h>
 
 
 #include "keystrokes.h"
+#include "x11trace.h"
+#include "x11threads.h"
+#include "x11arena.h"
+#include "x11framebuffer.h"
+#include "x11profiler.h"
+#include "x11text.h"
+#include "x11atlas.h"
+#include "x11wheel.h"
 #include "x11methods.h"
 
 namespace X11Grid
@@ -53,12 +75,181 @@ namespace X11Grid
 
 	struct Card
 	{
-		Card(const unsigned long _id) : id(_id) {}
+		Card(const unsigned long _id,const bool _opaque=false) : id(_id),z(_id),opaque(_opaque) {}
+		virtual ~Card() {}
 		virtual void operator()(Pixmap& bitmap,const int x,const int y,Display* display,GC& gc,X11Methods::InvalidBase& invalid) = 0;
 		operator const unsigned long (){return id;}
-		virtual void cover(Display*,GC&,Pixmap&,unsigned long,X11Methods::InvalidBase& invalid,const int Y,const int Y) = 0;
+		virtual void cover(Display*,GC&,Pixmap&,unsigned long,X11Methods::InvalidBase& invalid,const int X,const int Y) = 0;
+		virtual Extent bounds(const int x,const int y) const { return Extent(x,y,x+1,y+1); }
+		virtual bool move(const int x,const int y) { return false; }
+		unsigned long depth() const { return z; }
+		void depth(const unsigned long _z) { z=_z; }
+		bool solid() const { return opaque; }
 		protected:
 		const unsigned long id;
+		unsigned long z;
+		bool opaque;
+	};
+
+	struct ChunkHash
+	{
+		size_t operator()(const unsigned long long key) const
+			{ return static_cast<size_t>((key*0X9E3779B97F4A7C15ULL)>>17); }
+	};
+
+	struct ExtentIndex
+	{
+		enum {Bits=6};
+		ExtentIndex() : count(0) {}
+		void insert(const Extent& e,const void* tag=NULL)
+		{
+			if ((e.x2<=e.x1) || (e.y2<=e.y1)) return;
+			count++;
+			for (int bx=(e.x1>>Bits);bx<=((e.x2-1)>>Bits);bx++)
+				for (int by=(e.y1>>Bits);by<=((e.y2-1)>>Bits);by++)
+					buckets[Key(bx,by)].push_back(make_pair(e,tag));
+		}
+		bool contains(const Extent& e) const
+		{
+			Buckets::const_iterator bucket(buckets.find(Key(e.x1>>Bits,e.y1>>Bits)));
+			if (bucket==buckets.end()) return false;
+			for (Entries::const_iterator it=bucket->second.begin();it!=bucket->second.end();it++)
+				if (it->first>=e) return true;
+			return false;
+		}
+		bool holds(const Extent& e,const void* tag) const
+		{
+			Buckets::const_iterator bucket(buckets.find(Key(e.x1>>Bits,e.y1>>Bits)));
+			if (bucket==buckets.end()) return false;
+			for (Entries::const_iterator it=bucket->second.begin();it!=bucket->second.end();it++)
+				if ((it->second==tag) && (it->first==e)) return true;
+			return false;
+		}
+		bool overlaps(const Extent& e,const void* except=NULL) const
+		{
+			if ((e.x2<=e.x1) || (e.y2<=e.y1)) return false;
+			for (int bx=(e.x1>>Bits);bx<=((e.x2-1)>>Bits);bx++)
+				for (int by=(e.y1>>Bits);by<=((e.y2-1)>>Bits);by++)
+				{
+					Buckets::const_iterator bucket(buckets.find(Key(bx,by)));
+					if (bucket==buckets.end()) continue;
+					for (Entries::const_iterator it=bucket->second.begin();it!=bucket->second.end();it++)
+						if (((!except) || (it->second!=except)) && (it->first&e)) return true;
+				}
+			return false;
+		}
+		void operator()(const Extent& e,vector<Extent>& hits) const
+		{
+			if ((e.x2<=e.x1) || (e.y2<=e.y1)) return;
+			for (int bx=(e.x1>>Bits);bx<=((e.x2-1)>>Bits);bx++)
+				for (int by=(e.y1>>Bits);by<=((e.y2-1)>>Bits);by++)
+				{
+					Buckets::const_iterator bucket(buckets.find(Key(bx,by)));
+					if (bucket==buckets.end()) continue;
+					for (Entries::const_iterator it=bucket->second.begin();it!=bucket->second.end();it++)
+						if (it->first&e) hits.push_back(it->first);
+				}
+		}
+		bool empty() const { return !count; }
+		void clear() 
+		{ 
+			if (!count) return;
+			for (Buckets::iterator it=buckets.begin();it!=buckets.end();it++) it->second.clear();
+			count=0; 
+		}
+		private:
+		typedef vector<pair<Extent,const void*> > Entries;
+		typedef tr1::unordered_map<unsigned long long,Entries,ChunkHash> Buckets;
+		Buckets buckets;
+		size_t count;
+		static unsigned long long Key(const int bx,const int by) 
+			{ return (static_cast<unsigned long long>(static_cast<unsigned int>(bx))<<32)|static_cast<unsigned int>(by); }
+	};
+
+	template <typename Allocation>
+		struct CardIndex
+	{
+		enum {Bits=6};
+		void insert(Card* card,const int x,const int y,const Extent& e)
+		{
+			placed[make_pair(card,Point(x,y))]=e;
+			for (int bx=(e.x1>>Bits);bx<=((e.x2-1)>>Bits);bx++)
+				for (int by=(e.y1>>Bits);by<=((e.y2-1)>>Bits);by++)
+					buckets[Key(bx,by)].push_back(Entry(card,x,y,e));
+		}
+		bool erase(Card* card,const int x,const int y)
+		{
+			typename Placed::iterator found(placed.find(make_pair(card,Point(x,y))));
+			if (found==placed.end()) return false;
+			const Extent e(found->second);
+			placed.erase(found);
+			for (int bx=(e.x1>>Bits);bx<=((e.x2-1)>>Bits);bx++)
+				for (int by=(e.y1>>Bits);by<=((e.y2-1)>>Bits);by++)
+				{
+					typename Buckets::iterator bucket(buckets.find(Key(bx,by)));
+					if (bucket==buckets.end()) continue;
+					vector<Entry>& entries(bucket->second);
+					for (size_t i=0;i<entries.size();i++)
+						if ((entries[i].card==card) && (entries[i].anchor.first==x) && (entries[i].anchor.second==y))
+							{ entries[i]=entries.back(); entries.pop_back(); break; }
+				}
+			return true;
+		}
+		bool contains(Card* card) const
+		{
+			typename Placed::const_iterator found(placed.lower_bound(make_pair(card,Point(INT_MIN,INT_MIN))));
+			return ((found!=placed.end()) && (found->first.first==card));
+		}
+		Card* operator()(const int x,const int y,Point& anchor) const
+		{
+			typename Buckets::const_iterator bucket(buckets.find(Key(x>>Bits,y>>Bits)));
+			if (bucket==buckets.end()) return NULL;
+			Card* top(NULL);
+			unsigned long topz(0);
+			for (typename vector<Entry>::const_iterator it=bucket->second.begin();it!=bucket->second.end();it++)
+			{
+				const Extent& e(it->extent);
+				if ((x<e.x1) || (x>=e.x2) || (y<e.y1) || (y>=e.y2)) continue;
+				const unsigned long z(it->card->depth());
+				if ((top) && (z<topz)) continue;
+				top=it->card; topz=z; anchor=it->anchor;
+			}
+			return top;
+		}
+		template <typename F>
+			void operator()(const Extent& e,F& found) const
+		{
+			for (int bx=(e.x1>>Bits);bx<=((e.x2-1)>>Bits);bx++)
+				for (int by=(e.y1>>Bits);by<=((e.y2-1)>>Bits);by++)
+				{
+					typename Buckets::const_iterator bucket(buckets.find(Key(bx,by)));
+					if (bucket==buckets.end()) continue;
+					for (typename vector<Entry>::const_iterator it=bucket->second.begin();it!=bucket->second.end();it++)
+						if (e&it->extent) found(it->card,it->anchor.first,it->anchor.second);
+				}
+		}
+		private:
+		struct Entry
+		{
+			Entry(Card* _card,const int x,const int y,const Extent& _extent) : card(_card),anchor(x,y),extent(_extent) {}
+			Card* card;
+			Point anchor;
+			Extent extent;
+		};
+		struct AnchorLess
+		{
+			bool operator()(const pair<Card*,Point>& a,const pair<Card*,Point>& b) const
+			{
+				if (a.first!=b.first) return a.first<b.first;
+				return static_cast<const pair<int,int>&>(a.second)<static_cast<const pair<int,int>&>(b.second);
+			}
+		};
+		typedef map<pair<Card*,Point>,Extent,AnchorLess,typename Allocation::template Allocator<pair<const pair<Card*,Point>,Extent> >::type> Placed;
+		typedef tr1::unordered_map<unsigned long long,vector<Entry>,ChunkHash> Buckets;
+		Placed placed;
+		Buckets buckets;
+		static unsigned long long Key(const int bx,const int by) 
+			{ return (static_cast<unsigned long long>(static_cast<unsigned int>(bx))<<32)|static_cast<unsigned int>(by); }
 	};
 
 	struct CardCover
@@ -72,37 +263,142 @@ namespace X11Grid
 		int x,y;
 	};
 
-	struct Cell;
+	struct CardShift
+	{
+		CardShift(Card* _card,const unsigned long _color,const Point& _from,const Point& _to) :
+			card(_card),color(_color),from(_from),to(_to) {}
+		Card* card;
+		unsigned long color;
+		Point from,to;
+	};
+
+	struct DisplayList : vector<CardCover>
+	{
+		DisplayList() : painted(0),culled(0) {}
+		void operator()(Card* card,const int x,const int y) { push_back(CardCover(card,0,x,y)); }
+		void order()
+		{
+			sort(begin(),end(),Higher());
+			erase(unique(begin(),end(),Same()),end());
+			iterator kept(begin());
+			for (iterator it=begin();it!=end();it++)
+			{
+				const Extent e(it->card->bounds(it->x,it->y));
+				if (occluders.contains(e)) { culled++; continue; }
+				if (it->card->solid()) occluders.insert(e);
+				*kept++=*it;
+			}
+			erase(kept,end());
+			reverse(begin(),end());
+			occluders.clear();
+		}
+		unsigned long long painted,culled;
+		private:
+		struct Higher
+		{
+			bool operator()(const CardCover& a,const CardCover& b) const
+			{
+				if (a.card->depth()!=b.card->depth()) return a.card->depth()>b.card->depth();
+				if (a.card!=b.card) return a.card<b.card;
+				if (a.x!=b.x) return a.x<b.x;
+				return a.y<b.y;
+			}
+		};
+		struct Same
+		{
+			bool operator()(const CardCover& a,const CardCover& b) const
+				{ return (a.card==b.card) && (a.x==b.x) && (a.y==b.y); }
+		};
+		ExtentIndex occluders;
+	};
+
+	struct CellBase;
 	struct GridBase : map<string,int>
 	{
-		GridBase() : nextid(0) {}
+		GridBase() : dirty(true),origin(0,0),timed(false),nextid(0) {}
 		operator const unsigned long () { return ++nextid; }
+		operator Batch& () { return batch; }
+		void damage() { dirty=true; }
+		void damage(const int x,const int y) { dirty=true; Guard guard(spin); touched.push_back(Point(x,y)); }
+		virtual void place(Card* card,const int x,const int y) = 0;
+		virtual void lift(Card* card,const int x,const int y) = 0;
+		virtual void reshape(Card* card,const int x,const int y) = 0;
+		Point locate(const int px,const int py) const { return Point(px-origin.first,py-origin.second); }
+		unsigned long long ticks() const { return wheel.Now(); }
+		void expire(const int x,const int y,const unsigned long long when) { if (!timed) return; Guard guard(spin); wheel(when,Point(x,y)); }
+		void due(const unsigned long long now,vector<Point>& points) { Guard guard(spin); wheel(now,points); }
+		void move(Card* card,Point from,Point to);
+		virtual Pool* threads() { return NULL; }
+		struct Dot { unsigned long color; int x,y; };
 		virtual void operator()(const unsigned long color,Pixmap&  bitmap,const int x,const int y) = 0;
+		// plain cells a structure paints in a run; a grid overriding the single dot overrides this too
+		virtual void operator()(Pixmap& bitmap,const Dot* dots,const int n) = 0;
 		virtual int operator()(Card&,Pixmap&,const int x,const int y) = 0;
-		virtual Cell& operator[](Point& p) = 0;
+		// the CellBase& is good until the next update, which may erase the cell
+		virtual CellBase& operator[](Point& p) = 0;
 		friend ostream& operator<<(ostream&,GridBase&);
 		virtual ostream& operator<<(ostream& o) { for (iterator it=begin();it!=end();it++) o<<it->first<<":"<<setw(8)<<it->second<<" "; return o;}
 		virtual void cover(Card*,unsigned long color,const int x,const int y) = 0;
+		virtual void shift(Card*,unsigned long color,const Point& from,const Point& to) = 0;
+		protected:
+		Batch batch;
+		bool dirty;
+		vector<Point> touched;
+		SpinLock spin;
+		Point origin;
+		bool timed;
 		private:
+		TimingWheel<Point> wheel;
 		unsigned long nextid;
 		//virtual bool operator()(XEvent&,KeyMap&) {return true;}
 		virtual bool events(Pixmap& bitmap,KeyMap& keys) {return true;}
 	};
 	inline ostream& operator<<(ostream& o,GridBase& b){return b.operator<<(o);}
 
-	struct Cell 
+	// what a grid hands out for a point; the cards a cell holds are kept by Cell<DS>
+	struct CellBase
+	{
+		CellBase(GridBase& _grid,const int _x,const int _y,const unsigned long _background)
+			: grid(_grid), X(_x), Y(_y),color(0),background(_background),deactivate(false),active(true),deadline(0) {}
+		virtual ~CellBase() {}
+		virtual void operator=(unsigned long _color){color=_color; grid.damage(X,Y);}
+		virtual void remove(){deactivate=true; grid.damage(X,Y);}
+		virtual bool update(const unsigned long updateloop,const unsigned long) = 0;
+		virtual void expire(const unsigned long ticks) { deadline=grid.ticks()+max(ticks,1UL); grid.expire(X,Y,deadline); }
+		virtual void operator()(Pixmap& bitmap) = 0;
+		virtual void operator+=(Card* c) = 0;
+		virtual void operator-=(Card* c) { if (detach(c)) grid.cover(c,background,X,Y); }
+		virtual bool detach(Card* c) = 0;
+		unsigned long backdrop() const { return background; }
+		protected:				
+		GridBase& grid;
+		const int X,Y;
+		unsigned long color,background;
+		bool deactivate,active;
+		unsigned long long deadline;
+	};
+
+	template <typename DS>
+		struct Cell : CellBase
 	{
 		Cell(GridBase& _grid,const int _x,const int _y,const unsigned long _background)
-			: grid(_grid), X(_x), Y(_y),color(0),background(_background),deactivate(false),active(true) {}
-		void operator=(unsigned long _color){color=_color;}
-		void remove(){deactivate=true;}
-		virtual bool update(const unsigned long,const unsigned long) { return !active; }
+			: CellBase(_grid,_x,_y,_background) {}
+		using CellBase::operator=;
+		virtual bool update(const unsigned long updateloop,const unsigned long) 
+		{ 
+			if ((deadline) && (deadline<=updateloop)) { deadline=0; remove(); }
+			if (active) return false;
+			// the cell goes with this update, so its cards are taken off screen first
+			while (!cards.empty()) (*this)-=cards.begin()->second;
+			return true;
+		}
 		virtual void operator()(Pixmap& bitmap)
 		{ 
+			if ((deactivate) && (active)) grid.expire(X,Y,0);
 			if (deactivate) {color=background; active=false;}
 			if (!cards.empty()) 
 			{
-				for (map<unsigned long,Card*>::iterator cit=cards.begin();cit!=cards.end();cit++) 
+				for (typename Cards::iterator cit=cards.begin();cit!=cards.end();cit++) 
 					grid(*cit->second,bitmap,X,Y);
 			} else grid(color,bitmap,X,Y);
 		}
@@ -110,73 +406,144 @@ namespace X11Grid
 		{
 			if (!c) return;
 			const unsigned long id(*c);
+			if (cards.find(id)==cards.end()) grid.place(c,X,Y);
 			cards[id]=c;
+			active=true; deactivate=false;
+			grid.damage(X,Y);
 		}
-		virtual void operator-=(Card* c)
+		virtual bool detach(Card* c)
 		{
-			if (!c) return;
+			if (!c) return false;
 			const unsigned long id(*c);
-			map<unsigned long,Card*>::iterator it(cards.find(id));
-			if (it==cards.end()) return;
+			typename Cards::iterator it(cards.find(id));
+			if (it==cards.end()) return false;
 			cards.erase(it);
-			if (cards.empty()) active=false;
-			grid.cover(c,background,X,Y);
+			grid.lift(c,X,Y);
+			if (cards.empty()) { active=false; grid.expire(X,Y,0); }
+			grid.damage(X,Y);
+			return true;
 		}
 		protected:				
-		GridBase& grid;
-		const int X,Y;
-		unsigned long color,background;
-		bool deactivate,active;
-		map<unsigned long,Card*> cards;
+		typedef map<unsigned long,Card*,less<unsigned long>,typename DS::Allocation::template Allocator<pair<const unsigned long,Card*> >::type> Cards;
+		Cards cards;
+	};
+
+	inline void GridBase::move(Card* card,Point from,Point to)
+	{
+		if (from==to) return;
+		CellBase& source((*this)[from]);
+		const unsigned long color(source.backdrop());
+		const bool moved(source.detach(card));
+		(*this)[to]+=card;
+		if (moved) shift(card,color,from,to);
+	}
+
+	template <typename K,typename C>
+		struct Updates : Job, vector<pair<K,C*> >
+	{
+		Updates(const unsigned long _updateloop,const unsigned long _updaterate) : updateloop(_updateloop),updaterate(_updaterate) {}
+		void operator()(Pool& pool,vector<K>& kil)
+		{
+			results.assign(this->size(),0);
+			pool(*this,this->size());
+			for (size_t i=0;i<this->size();i++) if (results[i]) kil.push_back((*this)[i].first);
+		}
+		virtual void operator()(const int i) { results[i]=(*this)[i].second->update(updateloop,updaterate); }
+		private:
+		const unsigned long updateloop,updaterate;
+		vector<char> results;
 	};
 
 	template <typename DS>
-		struct Column : map<int,typename DS::CellType>
+		struct Column : map<int,typename DS::CellType,less<int>,typename DS::Allocation::template Allocator<pair<const int,typename DS::CellType> >::type>
 	{
 		Column(GridBase& _grid,const int _position) : grid(_grid),X(_position) {}
-		Cell& operator[](Point& p)
+		CellBase& operator[](Point& p)
 		{
-			typename DS::ColumnType::iterator found(this->find(p.second));
-			if (found!=this->end()) return found->second;
-			//insert(make_pair<int,typename DS::CellType>(p.second,typename DS::CellType(grid,p.first,p.second,0XFFFF00)));
-			pair<int,typename DS::CellType> pp(p.second,typename DS::CellType(grid,p.first,p.second,0XFFFF00));
-			this->insert( pp );
-			typename DS::ColumnType::iterator it(this->find(p.second));
-			if (it==this->end()) throw runtime_error("Cannot create column");
-			return it->second;
+			typename DS::ColumnType::iterator found(this->lower_bound(p.second));
+			if ((found!=this->end()) && (found->first==p.second)) return found->second;
+			#if __cplusplus>=201103L
+			found=this->emplace_hint(found,piecewise_construct,forward_as_tuple(p.second),forward_as_tuple(grid,p.first,p.second,0XFFFF00));
+			#else
+			found=this->insert(found,typename DS::ColumnType::value_type(p.second,typename DS::CellType(grid,p.first,p.second,0XFFFF00)));
+			#endif
+			return found->second;
 		}
 		virtual bool update(const unsigned long updateloop,const unsigned long updaterate)
 		{
-cout << "ColumnRate:" << updaterate << endl;
+			X11TraceVerbose("column update",X,updaterate);
 			if (this->empty()) return true;
-			vector< int > kil;
-			for (typename DS::ColumnType::iterator it=this->begin();it!=this->end();it++) 
-				if (it->second.update(updateloop,updaterate)) kil.push_back( it->first );//erase(it);
-			for ( vector< int >::iterator kit=kil.begin();kit!=kil.end();kit++)
-			{
-				typename DS::ColumnType::iterator found(this->find( *kit ));
-				if ( found != this->end() ) this->erase( found );				
-			}
+			for (typename DS::ColumnType::iterator it=this->begin();it!=this->end();) 
+				if (it->second.update(updateloop,updaterate)) { grid.damage(X,it->first); this->erase(it++); }
+				else it++;
 			if (this->empty()) return true;
 			return false;
 		}
+		bool reap(const Point& p,const unsigned long updateloop,const unsigned long updaterate)
+		{
+			typename DS::ColumnType::iterator found(this->find(p.second));
+			if ((found!=this->end()) && (found->second.update(updateloop,updaterate))) { grid.damage(X,p.second); this->erase(found); }
+			return this->empty();
+		}
 		virtual void operator()(Pixmap& bitmap)
 			{ for (typename DS::ColumnType::iterator it=this->begin();it!=this->end();it++) it->second(bitmap); }
+		virtual void operator()(Pixmap& bitmap,const Extent& e)
+		{ 
+			for (typename DS::ColumnType::iterator it=this->lower_bound(e.y1);(it!=this->end()) && (it->first<e.y2);it++) 
+				it->second(bitmap); 
+		}
 		protected:
 		GridBase& grid;
 		const int X;
 	};
 
 	template <typename DS>
-		struct Row : map<int,typename DS::ColumnType>
+		struct Row : map<int,typename DS::ColumnType,less<int>,typename DS::Allocation::template Allocator<pair<const int,typename DS::ColumnType> >::type>
 	{
 		Row(GridBase& _grid) : grid(_grid) {}
 		virtual void update(const unsigned long updateloop,const unsigned long updaterate)
 		{
-cout << "RowRate:" << updaterate << endl;
-			//grid.clear();
+			X11TraceVerbose("row update",this->size(),updaterate);
+			due.clear();
+			grid.due(updateloop,due);
+			sweep(updateloop,updaterate,typename DS::Expiry());
+		}
+		virtual void operator()(Pixmap& bitmap)
+			{ for (typename DS::RowType::iterator it=this->begin();it!=this->end();it++) it->second(bitmap); }
+		virtual void operator()(Pixmap& bitmap,const Extent& e)
+		{ 
+			for (typename DS::RowType::iterator it=this->lower_bound(e.x1);(it!=this->end()) && (it->first<e.x2);it++) 
+				it->second(bitmap,e); 
+		}
+		CellBase& operator[](Point& p)
+		{
+			typename DS::RowType::iterator found(this->lower_bound(p.first));
+			if ((found==this->end()) || (found->first!=p.first))
+				found=this->insert(found,typename DS::RowType::value_type(p.first,typename DS::ColumnType(grid,p.first)));
+			return found->second[p];
+		}
+		protected:
+		GridBase& grid;
+		private:
+		vector<Point> due;
+		void sweep(const unsigned long updateloop,const unsigned long updaterate,const TimedExpiry&)
+		{
+			for (vector<Point>::iterator it=due.begin();it!=due.end();it++)
+			{
+				typename DS::RowType::iterator found(this->find(it->first));
+				if ((found!=this->end()) && (found->second.reap(*it,updateloop,updaterate))) this->erase(found);
+			}
+		}
+		void sweep(const unsigned long updateloop,const unsigned long updaterate,const ScannedExpiry&)
+		{
 			vector< int > kil;
-			for (typename DS::RowType::iterator it=this->begin();it!=this->end();it++) 
+			Pool* pool(grid.threads());
+			if ((pool) && (this->size()>1))
+			{
+				Updates<int,typename DS::ColumnType> updates(updateloop,updaterate);
+				for (typename DS::RowType::iterator it=this->begin();it!=this->end();it++) updates.push_back(make_pair(it->first,&it->second));
+				updates(*pool,kil);
+			} else for (typename DS::RowType::iterator it=this->begin();it!=this->end();it++) 
 				if (it->second.update(updateloop,updaterate)) kil.push_back( it->first ); //this->erase(it);
 			for ( vector< int >::iterator kit=kil.begin();kit!=kil.end();kit++)
 			{
@@ -184,23 +551,394 @@ cout << "RowRate:" << updaterate << endl;
 				if ( found != this->end() ) this->erase( found );				
 			}
 		}
+	};
+
+	template <typename DS>
+		struct Chunk
+	{
+		typedef typename DS::CellType CellType;
+		typedef typename DS::Allocation::template Allocator<CellType>::type CellAllocator;
+		enum {Bits=DS::ChunkBits,Size=(1<<Bits),Mask=(Size-1),Cells=(Size*Size),Words=((Cells+63)/64)};
+		Chunk(GridBase& _grid,const int _cx,const int _cy) 
+			: grid(_grid),X(_cx<<Bits),Y(_cy<<Bits),population(0),cells(NULL)
+			{ memset(live,0,sizeof(live)); }
+		virtual ~Chunk() 
+		{ 
+			if (!cells) return;
+			for (int i=next(0);i<Cells;i=next(i+1)) release(i); 
+			cellallocator.deallocate(cells,Cells);
+		}
+		CellBase& operator[](Point& p)
+		{
+			const int i(index(p.first,p.second));
+			unsigned long long& word(live[i>>6]);
+			const unsigned long long bit(1ULL<<(i&63));
+			if (!(word&bit)) 
+			{
+				if (!cells) cells=cellallocator.allocate(Cells);
+				new (cells+i) CellType(grid,p.first,p.second,0XFFFF00);
+				word|=bit; population++;
+			}
+			return cells[i];
+		}
+		virtual bool update(const unsigned long updateloop,const unsigned long updaterate)
+		{
+			for (int i=next(0);i<Cells;i=next(i+1))
+				if (cells[i].update(updateloop,updaterate)) 
+				{
+					grid.damage(X+(i>>Bits),Y+(i&Mask));
+					release(i);
+					live[i>>6]&=~(1ULL<<(i&63));
+					population--;
+				}
+			return !population;
+		}
+		bool reap(const Point& p,const unsigned long updateloop,const unsigned long updaterate)
+		{
+			const int i(index(p.first,p.second));
+			unsigned long long& word(live[i>>6]);
+			const unsigned long long bit(1ULL<<(i&63));
+			if ((word&bit) && (cells[i].update(updateloop,updaterate)))
+			{
+				grid.damage(p.first,p.second);
+				release(i);
+				word&=~bit;
+				population--;
+			}
+			return !population;
+		}
 		virtual void operator()(Pixmap& bitmap)
-			{ for (typename DS::RowType::iterator it=this->begin();it!=this->end();it++) it->second(bitmap); }
-		Cell& operator[](Point& p)
+			{ for (int i=next(0);i<Cells;i=next(i+1)) cells[i](bitmap); }
+		virtual void operator()(Pixmap& bitmap,const Extent& e)
+		{
+			const int x1(max(e.x1,X)-X), x2(min(e.x2,X+Size)-X), y1(max(e.y1,Y)-Y), y2(min(e.y2,Y+Size)-Y);
+			for (int x=x1;x<x2;x++)
+				for (int i=(x<<Bits)+y1;i<(x<<Bits)+y2;i++)
+					if (live[i>>6]&(1ULL<<(i&63))) cells[i](bitmap);
+		}
+		bool empty() const { return !population; }
+		protected:
+		GridBase& grid;
+		const int X,Y;
+		int population;
+		// one slab of raw storage for all the cells, taken when the first comes alive and
+		// kept until the chunk goes; a slot holds a constructed cell only while its live bit is set
+		CellType* cells;
+		unsigned long long live[Words];
+		CellAllocator cellallocator;
+		void release(const int i) { cells[i].~CellType(); }
+		static int index(const int x,const int y) { return ((x&Mask)<<Bits)|(y&Mask); }
+		int next(int i) const
+		{
+			while (i<Cells)
+			{
+				const unsigned long long word(live[i>>6]>>(i&63));
+				if (word) return i+__builtin_ctzll(word);
+				i=(i|63)+1;
+			}
+			return Cells;
+		}
+		private:
+		Chunk(const Chunk&);
+		void operator=(const Chunk&);
+	};
+
+	template <typename DS> struct PackedChunk;
+
+	template <typename DS>
+		struct PackedCell : CellBase
+	{
+		PackedCell(GridBase& _grid,PackedChunk<DS>& _chunk,const int _i,const int _x,const int _y)
+			: CellBase(_grid,_x,_y,_chunk.background[_i]), chunk(_chunk), i(_i) {}
+		// the chunk updates and paints its own cells
+		virtual bool update(const unsigned long,const unsigned long) { return false; }
+		virtual void operator()(Pixmap& bitmap) { chunk(bitmap,Extent(X,Y,X+1,Y+1)); }
+		virtual void operator=(unsigned long _color)
+		{
+			if (held()) { chunk.promote(i,X,Y)=_color; return; }
+			chunk.color[i]=_color; grid.damage(X,Y);
+		}
+		virtual void remove()
+		{
+			if (held()) { chunk.promote(i,X,Y).remove(); return; }
+			chunk.flags[i]|=PackedChunk<DS>::Deactivate; chunk.pending[i>>6]|=1ULL<<(i&63); chunk.removing=true; grid.damage(X,Y);
+		}
+		virtual void operator+=(Card* c) { if (c) chunk.promote(i,X,Y)+=c; }
+		virtual void operator-=(Card* c) { if (held()) chunk.promote(i,X,Y)-=c; }
+		virtual bool detach(Card* c) { return (held()) && (chunk.promote(i,X,Y).detach(c)); }
+		// a deadline needs a cell of its own to live in
+		virtual void expire(const unsigned long ticks) { chunk.promote(i,X,Y).expire(ticks); }
+		private:
+		bool held() const { return chunk.flags[i]&PackedChunk<DS>::Carded; }
+		PackedChunk<DS>& chunk;
+		const int i;
+	};
+
+	template <typename DS>
+		struct PackedChunk
+	{
+		friend struct PackedCell<DS>;
+		typedef typename DS::CellType CellType;
+		enum {Bits=DS::ChunkBits,Size=(1<<Bits),Mask=(Size-1),Cells=(Size*Size),Words=((Cells+63)/64)};
+		enum {Live=1,Active=2,Deactivate=4,Carded=8};
+		PackedChunk(GridBase& _grid,const int _cx,const int _cy) 
+			: grid(_grid),X(_cx<<Bits),Y(_cy<<Bits),population(0),dead(0),removing(false),lent(0),lending(0)
+		{ 
+			memset(flags,0,sizeof(flags)); 
+			memset(color,0,sizeof(color)); 
+			memset(pending,0,sizeof(pending)); 
+		}
+		virtual ~PackedChunk()
+		{
+			recycle();
+			for (typename vector<PackedCell<DS>*>::iterator it=proxies.begin();it!=proxies.end();it++) ::operator delete(*it);
+			for (typename map<int,CellType*>::iterator it=carded.begin();it!=carded.end();it++) delete it->second;
+		}
+		// plain cells are lent a proxy of their own, which holds until the next update
+		// as cells of the other structures do; the proxies go back to the pool after it
+		CellBase& operator[](Point& p)
+		{
+			const int i(((p.first&Mask)<<Bits)|(p.second&Mask));
+			if (flags[i]&Carded) return *carded[i];
+			if (!(flags[i]&Live)) 
+			{
+				color[i]=0; background[i]=0XFFFF00;
+				flags[i]=Live|Active; population++;
+			}
+			if (lending!=grid.ticks()) { recycle(); lending=grid.ticks(); }
+			if (lent==static_cast<int>(proxies.size())) proxies.push_back(static_cast<PackedCell<DS>*>(::operator new(sizeof(PackedCell<DS>))));
+			return *new (proxies[lent++]) PackedCell<DS>(grid,*this,i,p.first,p.second);
+		}
+		// only carded cells and cells painted out since the last update need a visit
+		virtual bool update(const unsigned long updateloop,const unsigned long updaterate)
+		{
+			for (typename map<int,CellType*>::iterator it=carded.begin();it!=carded.end();)
+			{
+				if (!it->second->update(updateloop,updaterate)) { it++; continue; }
+				grid.damage(X+(it->first>>Bits),Y+(it->first&Mask));
+				flags[it->first]=0; population--;
+				delete it->second;
+				carded.erase(it++);
+			}
+			bury();
+			return !population;
+		}
+		bool reap(const Point& p,const unsigned long updateloop,const unsigned long updaterate)
+		{
+			const int i(((p.first&Mask)<<Bits)|(p.second&Mask));
+			if (flags[i]&Carded)
+			{
+				typename map<int,CellType*>::iterator it(carded.find(i));
+				if (it->second->update(updateloop,updaterate)) 
+				{
+					grid.damage(p.first,p.second);
+					delete it->second;
+					carded.erase(it);
+					flags[i]=0; population--;
+				}
+			}
+			bury();
+			return !population;
+		}
+		virtual void operator()(Pixmap& bitmap) { (*this)(bitmap,Extent(X,Y,X+Size,Y+Size)); }
+		virtual void operator()(Pixmap& bitmap,const Extent& e)
+		{
+			const int x1(max(e.x1,X)-X), x2(min(e.x2,X+Size)-X), y1(max(e.y1,Y)-Y), y2(min(e.y2,Y+Size)-Y);
+			if ((x1>=x2) || (y1>=y2)) return;
+			deactivate();
+			GridBase::Dot dots[Size];
+			for (int x=x1;x<x2;x++)
+			{
+				int n(0);
+				for (int i=(x<<Bits)+y1;i<(x<<Bits)+y2;i++)
+				{
+					const unsigned char f(flags[i]);
+					if (!(f&Live)) continue;
+					if (f&Carded) 
+					{ 
+						if (n) { grid(bitmap,dots,n); n=0; }
+						(*carded[i])(bitmap); 
+						continue; 
+					}
+					dots[n].color=color[i]; dots[n].x=X+x; dots[n].y=Y+(i&Mask); n++;
+				}
+				if (n) grid(bitmap,dots,n);
+			}
+		}
+		bool empty() const { return !population; }
+		protected:
+		GridBase& grid;
+		const int X,Y;
+		int population,dead;
+		unsigned long color[Cells],background[Cells];
+		unsigned char flags[Cells];
+		map<int,CellType*> carded;
+		bool removing;
+		unsigned long long pending[Words];
+		// removed cells take their background in one branch-free pass over the words holding any;
+		// every removed cell is damaged, so it is painted this frame whichever slice runs the pass
+		void deactivate()
+		{
+			if (!removing) return;
+			removing=false;
+			int dying(0);
+			for (int w=0;w<Words;w++)
+			{
+				if (!pending[w]) continue;
+				for (int i=(w<<6);i<min((w+1)<<6,static_cast<int>(Cells));i++)
+				{
+					const unsigned char f(flags[i]);
+					const unsigned long d((f&Deactivate)>>2), mask(-d);
+					color[i]=(color[i]&~mask)|(background[i]&mask);
+					dying+=d&((f&Active)>>1);
+					flags[i]=f&~(d<<1);
+				}
+				pending[w]=0;
+			}
+			// one wheel entry brings the chunk back to bury all of them
+			if (dying) { dead+=dying; grid.expire(X,Y,0); }
+		}
+		void bury()
+		{
+			if (!dead) return;
+			for (int i=0;i<Cells;i++) 
+				if ((flags[i]&(Live|Active|Carded))==Live) { grid.damage(X+(i>>Bits),Y+(i&Mask)); flags[i]=0; population--; }
+			dead=0;
+		}
+		CellType& promote(const int i,const int x,const int y)
+		{
+			if (flags[i]&Carded) return *carded[i];
+			CellType* c(new CellType(grid,x,y,background[i]));
+			*c=color[i];
+			if (flags[i]&Deactivate) c->remove();
+			carded[i]=c;
+			flags[i]=Live|Active|Carded;
+			return *c;
+		}
+		private:
+		vector<PackedCell<DS>*> proxies;
+		int lent;
+		unsigned long long lending;
+		void recycle()
+		{
+			for (int j=0;j<lent;j++) proxies[j]->~PackedCell<DS>();
+			lent=0;
+		}
+		PackedChunk(const PackedChunk&);
+		void operator=(const PackedChunk&);
+	};
+
+	template <typename DS>
+		struct Chunks : tr1::unordered_map<unsigned long long,typename DS::ColumnType*,ChunkHash,equal_to<unsigned long long>,
+			typename DS::Allocation::template Allocator<pair<const unsigned long long,typename DS::ColumnType*> >::type>
+	{
+		typedef typename DS::ColumnType ChunkType;
+		typedef tr1::unordered_map<unsigned long long,ChunkType*,ChunkHash,equal_to<unsigned long long>,
+			typename DS::Allocation::template Allocator<pair<const unsigned long long,ChunkType*> >::type> ChunkMap;
+		Chunks(GridBase& _grid) : grid(_grid),lastkey(0),last(NULL),stale(false) {}
+		virtual ~Chunks() { for (typename ChunkMap::iterator it=this->begin();it!=this->end();it++) delete it->second; }
+		virtual void update(const unsigned long updateloop,const unsigned long updaterate)
+		{
+			due.clear();
+			grid.due(updateloop,due);
+			sweep(updateloop,updaterate,typename DS::Expiry());
+		}
+		virtual void operator()(Pixmap& bitmap) { (*this)(bitmap,Extent(INT_MIN,INT_MIN,INT_MAX,INT_MAX)); }
+		// cells are painted column by column across the chunks, the same order a Row of Columns paints in
+		virtual void operator()(Pixmap& bitmap,const Extent& e)
+		{
+			if ((e.x2<=e.x1) || (e.y2<=e.y1)) return;
+			const vector<Placed>& placed(ordered());
+			if (placed.empty()) return;
+			const int cy1(e.y1>>ChunkType::Bits), cy2((e.y2-1)>>ChunkType::Bits);
+			typename vector<Placed>::const_iterator first(lower_bound(placed.begin(),placed.end(),Placed(make_pair(e.x1>>ChunkType::Bits,INT_MIN),NULL)));
+			while ((first!=placed.end()) && (first->first.first<=((e.x2-1)>>ChunkType::Bits)))
+			{
+				const int cx(first->first.first);
+				typename vector<Placed>::const_iterator last(first);
+				while ((last!=placed.end()) && (last->first.first==cx)) last++;
+				typename vector<Placed>::const_iterator from(lower_bound(first,last,Placed(make_pair(cx,cy1),NULL)));
+				typename vector<Placed>::const_iterator to(lower_bound(from,last,Placed(make_pair(cx,cy2+1),NULL)));
+				const int x1(max(e.x1,cx<<ChunkType::Bits)), x2(min(e.x2,(cx<<ChunkType::Bits)+ChunkType::Size));
+				if (from!=to) for (int x=x1;x<x2;x++) 
+					for (typename vector<Placed>::const_iterator it=from;it!=to;it++) (*it->second)(bitmap,Extent(x,e.y1,x+1,e.y2));
+				first=last;
+			}
+		}
+		CellBase& operator[](Point& p)
 		{
-			typename DS::RowType::iterator found(this->find(p.first));
-			if (found==this->end()) 
+			const int cx(p.first>>ChunkType::Bits), cy(p.second>>ChunkType::Bits);
+			const unsigned long long key(Key(cx,cy));
+			if ((!last) || (key!=lastkey))
 			{
-				pair<int,typename DS::ColumnType> pp(p.first,typename DS::ColumnType(grid,p.first));
-				this->insert( pp );
+				typename ChunkMap::iterator found(this->find(key));
+				if (found==this->end()) 
+				{
+					found=this->insert(make_pair(key,new ChunkType(grid,cx,cy))).first;
+					stale=true;
+				}
+				last=found->second; lastkey=key;
 			}
-			//insert(make_pair<int,typename DS::ColumnType>(p.first,typename DS::ColumnType(grid,p.first)));
-			typename DS::RowType::iterator it(this->find(p.first));
-			if (it==this->end()) throw runtime_error("Cannot create row");
-			return it->second[p];
+			return (*last)[p];
 		}
 		protected:
 		GridBase& grid;
+		static unsigned long long Key(const int cx,const int cy) 
+			{ return (static_cast<unsigned long long>(static_cast<unsigned int>(cx))<<32)|static_cast<unsigned int>(cy); }
+		private:
+		typedef pair<pair<int,int>,ChunkType*> Placed;
+		unsigned long long lastkey;
+		ChunkType* last;
+		vector<Point> due;
+		vector<Placed> order;
+		bool stale;
+		const vector<Placed>& ordered()
+		{
+			if (!stale) return order;
+			order.clear();
+			for (typename ChunkMap::iterator it=this->begin();it!=this->end();it++) 
+				order.push_back(Placed(make_pair(static_cast<int>(it->first>>32),static_cast<int>(it->first&0XFFFFFFFF)),it->second));
+			sort(order.begin(),order.end());
+			stale=false;
+			return order;
+		}
+		void sweep(const unsigned long updateloop,const unsigned long updaterate,const TimedExpiry&)
+		{
+			for (vector<Point>::iterator it=due.begin();it!=due.end();it++)
+			{
+				typename ChunkMap::iterator found(this->find(Key(it->first>>ChunkType::Bits,it->second>>ChunkType::Bits)));
+				if ((found==this->end()) || (!found->second->reap(*it,updateloop,updaterate))) continue;
+				if ( found->second == last ) last=NULL;
+				delete found->second;
+				this->erase( found );
+				stale=true;
+			}
+		}
+		void sweep(const unsigned long updateloop,const unsigned long updaterate,const ScannedExpiry&)
+		{
+			vector< unsigned long long > kil;
+			const vector<Placed>& placed(ordered());
+			Pool* pool(grid.threads());
+			if ((pool) && (placed.size()>1))
+			{
+				Updates<unsigned long long,ChunkType> updates(updateloop,updaterate);
+				for (typename vector<Placed>::const_iterator it=placed.begin();it!=placed.end();it++) 
+					updates.push_back(make_pair(Key(it->first.first,it->first.second),it->second));
+				updates(*pool,kil);
+			} else for (typename vector<Placed>::const_iterator it=placed.begin();it!=placed.end();it++) 
+				if (it->second->update(updateloop,updaterate)) kil.push_back( Key(it->first.first,it->first.second) );
+			for ( vector< unsigned long long >::iterator kit=kil.begin();kit!=kil.end();kit++)
+			{
+				typename ChunkMap::iterator found(this->find( *kit ));
+				if ( found == this->end() ) continue;
+				if ( found->second == last ) last=NULL;
+				delete found->second;
+				this->erase( found );				
+				stale=true;
+			}
+		}
+		Chunks(const Chunks&);
+		void operator=(const Chunks&);
 	};
 
 	template <typename DS>
@@ -208,39 +946,307 @@ cout << "RowRate:" << updaterate << endl;
 	{
 		Grid(Display* _display,GC& _gc,const int _ScreenWidth, const int _ScreenHeight,const unsigned long _bkcolor)
 			: Canvas(_display,_gc,_ScreenWidth,_ScreenHeight), DS::RowType(static_cast<GridBase&>(*this)),
-				updateloop(0),bkcolor(_bkcolor) {}
-		virtual Cell& operator[](Point& p) { return DS::RowType::operator[](p); }
+				bkcolor(_bkcolor),updateloop(0),reach(2),clipped(false),full(true),tiler(NULL),dragging(NULL),moved(false) 
+				{ timed=DS::Expiry::Timed; }
+		virtual ~Grid() { if (tiler) delete tiler; }
+		virtual CellBase& operator[](Point& p) { return DS::RowType::operator[](p); }
+		virtual void place(Card* card,const int x,const int y) { Guard guard(spin); index.insert(card,x,y,card->bounds(x,y)); }
+		virtual void lift(Card* card,const int x,const int y) { Guard guard(spin); index.erase(card,x,y); }
+		virtual void reshape(Card* card,const int x,const int y) 
+		{ 
+			{ 
+				Guard guard(spin); 
+				if (!index.erase(card,x,y)) return;
+				index.insert(card,x,y,card->bounds(x,y)); 
+			}
+			damage(x,y);
+		}
+		virtual bool damaged() { return dirty; }
+		virtual Pool* threads() { return pool; }
+		virtual void expose() { full=true; dirty=true; }
+		const DisplayList& cards() const { return pending; }
+		virtual void expose(const int x,const int y,const int w,const int h) 
+			{ exposed.push_back(Extent(x,y,x+w,y+h)); dirty=true; }
 		protected:
 		const unsigned long bkcolor;
+		CardIndex<typename DS::Allocation> index;
 		virtual void update() { }
 		virtual void operator()(Pixmap& bitmap)
 		{ 
+			drag();
+			dirty=false;
+			if (framebuffer) framebuffer->Wait();
+			tiling();
+			InvalidBase& _invalid(*this);
+			{
+				Profile profile(profiler,Profiler::Cover);
+				scroll(bitmap);
+				for (vector<CardCover>::iterator coverit=coverup.begin();coverit!=coverup.end();coverit++)
+				{
+					CardCover& p(*coverit);
+					p.card->cover(display,gc,bitmap,p.color,_invalid,p.x,p.y);
+				}
+				coverup.clear();
+				flush(bitmap);
+			}
+			Profile profile(profiler,Profiler::Rows);
+			// cells are one layer: their dots go out a color at a time, between the covers and the cards
+			batch.Layer(true);
+			if (full) DS::RowType::operator()(bitmap);
+			else
+			{
+				// a dot paints over its neighbours, so every cell reaching into a damaged rect is
+				// repainted in traversal order, clipped to the rect, just as a full repaint leaves it
+				const size_t external(exposed.size());
+				repaint.assign(exposed.begin(),exposed.end());
+				regions.clear();
+				_invalid.Collect(regions);
+				for (vector<XRectangle>::iterator it=regions.begin();it!=regions.end();it++)
+					repaint.push_back(Extent(it->x,it->y,it->x+it->width,it->y+it->height));
+				sort(touched.begin(),touched.end());
+				touched.erase(unique(touched.begin(),touched.end()),touched.end());
+				for (vector<Point>::iterator it=touched.begin();it!=touched.end();it++)
+					repaint.push_back(Extent(it->first-reach,it->second-reach,it->first+reach,it->second+reach));
+				coalesce(repaint);
+				clipped=true;
+				for (vector<Extent>::iterator it=repaint.begin();it!=repaint.end();it++)
+				{
+					clip=*it;
+					DS::RowType::operator()(bitmap,Extent(it->x1-reach+1,it->y1-reach+1,it->x2+reach,it->y2+reach));
+				}
+				clipped=false;
+				// cards under anything painted this pass, and under restored background, go again
+				regions.clear();
+				_invalid.Collect(regions);
+				for (vector<XRectangle>::iterator it=regions.begin();it!=regions.end();it++)
+					index(Extent(it->x,it->y,it->x+it->width,it->y+it->height),pending);
+				for (size_t i=0;i<external;i++) index(exposed[i],pending);
+				overlapping();
+				for (size_t i=0;i<external;i++)
+				{
+					XRectangle r; r.x=exposed[i].x1; r.y=exposed[i].y1; r.width=exposed[i].x2-exposed[i].x1; r.height=exposed[i].y2-exposed[i].y1;
+					regions.push_back(r);
+				}
+			}
+			batch.Layer(false);
+			flush(bitmap);
+			// everything under the cards is in the framebuffer now; the cards go over it through X
+			if ((framebuffer) && (full)) framebuffer->Put(bitmap,gc);
+			else if (framebuffer) framebuffer->Put(bitmap,gc,regions);
+			full=false;
+			touched.clear();
+			exposed.clear();
+			pending.order();
+			if (!scrolled.empty()) 
+				for (DisplayList::iterator it=pending.begin();it!=pending.end();it++) 
+					current.insert(it->card->bounds(it->x,it->y),it->card);
+			shown.clear();
+			for (DisplayList::iterator it=pending.begin();it!=pending.end();it++)
+			{
+				const Extent e(it->card->bounds(it->x,it->y));
+				shown.push_back(make_pair(it->card,e));
+				if ((!scrolled.empty()) && (scrolled.holds(e,it->card)) && (!current.overlaps(e,it->card))) 
+					{ _invalid.insert(e.x1,e.y1,e.x2,e.y2); continue; }
+				(*it->card)(bitmap,it->x,it->y,display,gc,_invalid);
+				pending.painted++;
+			}
+			pending.clear();
+			scrolled.clear();
+			current.clear();
+			flush(bitmap,true);
+		}
+		void overlapping()
+		{
+			// a repainted card draws over what it overlaps, so cards above it are repainted too
+			marked.clear();
+			for (size_t i=0;i<pending.size();i++)
+			{
+				const CardCover c(pending[i]);
+				if (!marked.insert(make_pair(c.card,Point(c.x,c.y))).second) continue;
+				const size_t n(pending.size());
+				index(c.card->bounds(c.x,c.y),pending);
+				for (size_t j=n;j<pending.size();)
+					if (pending[j].card->depth()<c.card->depth()) { pending[j]=pending.back(); pending.pop_back(); }
+					else j++;
+			}
+		}
+		void flush(Pixmap& bitmap,const bool put=false)
+		{
+			if ((framebuffer) && ((!put) || (!framebuffer->Shared()))) 
+			{
+				batch.Flush(target());
+				if (tiler) (*tiler)();
+			} else batch.Flush(display,bitmap,gc);
+		}
+		Backend& target() 
+		{ 
+			if (tiler) return *tiler;
+			return *framebuffer;
+		}
+		void tiling()
+		{
+			if ((tiler) && ((!pool) || (!framebuffer) || (!(*tiler)(*framebuffer,*pool)))) { delete tiler; tiler=NULL; }
+			if ((!tiler) && (pool) && (framebuffer)) tiler=new Tiler(*framebuffer,*pool);
+		}
+		void scroll(Pixmap& bitmap)
+		{
+			if (shifts.empty()) return;
+			const bool able((!full) && ((!framebuffer) || (!framebuffer->Shared())));
+			covered.clear(); before.clear();
+			for (vector<CardCover>::iterator it=coverup.begin();it!=coverup.end();it++)
+				covered.insert(it->card->bounds(it->x,it->y));
+			// rects the buffers restored from the background no longer hold last frame's pixels
+			for (vector<Extent>::iterator it=exposed.begin();it!=exposed.end();it++) covered.insert(*it);
+			for (vector<CardShift>::iterator it=shifts.begin();it!=shifts.end();it++)
+			{
+				covered.insert(it->card->bounds(it->from.first,it->from.second),it->card);
+				covered.insert(it->card->bounds(it->to.first,it->to.second),it->card);
+			}
+			for (vector<pair<Card*,Extent> >::iterator it=shown.begin();it!=shown.end();it++)
+				before.insert(it->second,it->first);
+			flush(bitmap);
 			InvalidBase& _invalid(*this);
-			for (vector<CardCover>::iterator coverit=coverup.begin();coverit!=coverup.end();coverit++)
+			// pixels from off screen cannot be copied, so only cards wholly on screen both sides scroll
+			const Extent screen(0,0,ScreenWidth,ScreenHeight);
+			for (vector<CardShift>::iterator it=shifts.begin();it!=shifts.end();it++)
 			{
-				CardCover& p(*coverit);
-				p.card->cover(display,gc,bitmap,p.color,_invalid,p.x,p.y);
+				const Extent was(it->card->bounds(it->from.first,it->from.second)), now(it->card->bounds(it->to.first,it->to.second));
+				if ((!able) || (!it->card->solid()) || (!(screen>=was)) || (!(screen>=now)) 
+					|| (!before.holds(was,it->card)) || (before.overlaps(was,it->card))
+					|| (covered.overlaps(was,it->card)) || (covered.overlaps(now,it->card)))
+				{
+					coverup.push_back(CardCover(it->card,it->color,it->from.first,it->from.second));
+					continue;
+				}
+				if (framebuffer) target().Copy(*framebuffer,was.x1,was.y1,was.x2-was.x1,was.y2-was.y1,now.x1,now.y1);
+				else XCopyArea(display,bitmap,bitmap,gc,was.x1,was.y1,was.x2-was.x1,was.y2-was.y1,now.x1,now.y1);
+				Extent strips[4];
+				for (int i=0,n(was.minus(now,strips));i<n;i++)
+				{
+					batch.Fill(it->color,strips[i].x1,strips[i].y1,strips[i].x2-strips[i].x1,strips[i].y2-strips[i].y1);
+					_invalid.insert(strips[i].x1,strips[i].y1,strips[i].x2,strips[i].y2);
+				}
+				scrolled.insert(now,it->card);
 			}
-			coverup.clear();
-			DS::RowType::operator()(bitmap);
+			shifts.clear();
 		}
 		unsigned long updateloop;
-		virtual void operator()(const unsigned long color,Pixmap&  bitmap,const int x,const int y) {}
+		virtual void operator()(const unsigned long color,Pixmap&  bitmap,const int x,const int y) { fill(color,x,y); }
+		virtual void operator()(Pixmap& bitmap,const Dot* dots,const int n) 
+			{ for (int i=0;i<n;i++) fill(dots[i].color,dots[i].x,dots[i].y); }
+		void fill(const unsigned long color,const int x,const int y)
+		{
+			InvalidBase& _invalid(*this);
+			Extent dot(x-reach,y-reach,x+reach,y+reach);
+			if (clipped)
+			{
+				dot=Extent(max(dot.x1,clip.x1),max(dot.y1,clip.y1),min(dot.x2,clip.x2),min(dot.y2,clip.y2));
+				if ((dot.x2<=dot.x1) || (dot.y2<=dot.y1)) return;
+			}
+			if ((scrolled.empty()) || (!scrolled.overlaps(dot))) fill(color,dot);
+			else
+			{
+				pieces.assign(1,dot); hits.clear();
+				scrolled(dot,hits);
+				for (vector<Extent>::iterator hit=hits.begin();hit!=hits.end();hit++)
+				{
+					next.clear();
+					for (vector<Extent>::iterator it=pieces.begin();it!=pieces.end();it++)
+					{
+						Extent cut[4];
+						next.insert(next.end(),cut,cut+it->minus(*hit,cut));
+					}
+					pieces.swap(next);
+				}
+				for (vector<Extent>::iterator it=pieces.begin();it!=pieces.end();it++) fill(color,*it);
+			}
+			_invalid.insert(dot.x1,dot.y1,dot.x2,dot.y2);
+		}
+		void fill(const unsigned long color,const Extent& e)
+		{
+			if (tiler) tiler->Fill(color,e.x1,e.y1,e.x2-e.x1,e.y2-e.y1);
+			else if (framebuffer) framebuffer->Fill(color,e.x1,e.y1,e.x2-e.x1,e.y2-e.y1);
+			else batch.Fill(color,e.x1,e.y1,e.x2-e.x1,e.y2-e.y1);
+		}
 		virtual int operator()(Card& card,Pixmap& bitmap,const int x,const int y)
 		{ 
-			InvalidBase& _invalid(*this);
-			card(bitmap,x,y,display,gc,_invalid); 
+			pending(&card,x,y);
+			return 0;
+		}
+		virtual bool operator()(XEvent& e,KeyMap& keys)
+		{
+			if (e.type==ButtonPress)
+			{
+				const Point p(locate(e.xbutton.x,e.xbutton.y));
+				Point anchor;
+				dragging=index(p.first,p.second,anchor);
+				if (dragging) { grab=Point(p.first-anchor.first,p.second-anchor.second); pointer=p; moved=false; }
+			}
+			if ((e.type==MotionNotify) && (dragging))
+			{
+				int px(e.xmotion.x),py(e.xmotion.y);
+				if ((e.xmotion.is_hint) && (display)) 
+				{ 
+					Window root,child; int rx,ry; unsigned int mask; 
+					XQueryPointer(display,e.xmotion.window,&root,&child,&rx,&ry,&px,&py,&mask); 
+				}
+				pointer=locate(px,py);
+				moved=true; damage();
+			}
+			if (e.type==ButtonRelease) { drag(); dragging=NULL; }
+			return true;
 		}
 		virtual operator InvalidBase& () = 0;
+		int reach;
 		private:
 		virtual void cover(Card* c,unsigned long color,const int x,const int y)
 		{
+			Guard guard(spin);
 			CardCover cover(c,color,x,y);
+			for (vector<CardShift>::iterator it=shifts.begin();it!=shifts.end();it++)
+				if ((it->card==c) && (it->to==Point(x,y))) 
+					{ cover.x=it->from.first; cover.y=it->from.second; shifts.erase(it); break; }
 			coverup.push_back(cover);
+			damage();
 		} 
+		virtual void shift(Card* c,unsigned long color,const Point& from,const Point& to)
+		{
+			damage();
+			for (vector<CardShift>::iterator it=shifts.begin();it!=shifts.end();it++)
+				if ((it->card==c) && (it->to==from)) 
+				{ 
+					it->to=to; 
+					if (it->from==it->to) shifts.erase(it);
+					return; 
+				}
+			shifts.push_back(CardShift(c,color,from,to));
+		}
 		virtual bool events(Pixmap& bitmap,KeyMap& keys) {return true;}
 		//virtual bool operator()(XEvent&,KeyMap&) {return true;}
 		vector<CardCover> coverup;
+		vector<pair<Card*,Extent> > shown;
+		vector<CardShift> shifts;
+		DisplayList pending;
+		ExtentIndex scrolled,current,covered,before;
+		vector<Extent> pieces,hits,next;
+		vector<Extent> exposed,repaint;
+		vector<XRectangle> regions;
+		Coalesce coalesce;
+		Extent clip;
+		bool clipped;
+		set<pair<Card*,Point>,less<pair<Card*,Point> >,typename DS::Allocation::template Allocator<pair<Card*,Point> >::type> marked;
+		bool full;
+		Tiler* tiler;
+		Card* dragging;
+		Point grab,pointer;
+		bool moved;
+		void drag()
+		{
+			if ((!dragging) || (!moved)) return;
+			moved=false;
+			if (!index.contains(dragging)) { dragging=NULL; return; }
+			dragging->move(pointer.first-grab.first,pointer.second-grab.second);
+		}
 	};
 
 
@@ -249,8 +1255,59 @@ cout << "RowRate:" << updaterate << endl;
 		typedef Program ProgramType;
 		typedef Grid<DefaultStructure> GridType;
 		typedef Column<DefaultStructure> ColumnType;
-		typedef Row<ColumnType> RowType;
-		typedef Cell CellType;
+		typedef Row<DefaultStructure> RowType;
+		typedef Cell<DefaultStructure> CellType;
+		typedef StandardAllocation Allocation;
+		typedef ScannedExpiry Expiry;
+	};
+
+	// Expired cells come due on a timing wheel instead of a per tick scan; only
+	// cells that deactivate or call expire() are visited by update, so overrides
+	// of Cell::update and Column::update are not called every tick
+	struct TimedStructure
+	{
+		typedef Program ProgramType;
+		typedef Grid<TimedStructure> GridType;
+		typedef Column<TimedStructure> ColumnType;
+		typedef Row<TimedStructure> RowType;
+		typedef Cell<TimedStructure> CellType;
+		typedef StandardAllocation Allocation;
+		typedef TimedExpiry Expiry;
+	};
+
+	struct PooledStructure
+	{
+		typedef Program ProgramType;
+		typedef Grid<PooledStructure> GridType;
+		typedef Column<PooledStructure> ColumnType;
+		typedef Row<PooledStructure> RowType;
+		typedef Cell<PooledStructure> CellType;
+		typedef ArenaAllocation Allocation;
+		typedef ScannedExpiry Expiry;
+	};
+
+	struct ChunkedStructure
+	{
+		typedef Program ProgramType;
+		typedef Grid<ChunkedStructure> GridType;
+		typedef Chunk<ChunkedStructure> ColumnType;
+		typedef Chunks<ChunkedStructure> RowType;
+		typedef Cell<ChunkedStructure> CellType;
+		typedef StandardAllocation Allocation;
+		typedef ScannedExpiry Expiry;
+		enum {ChunkBits=4};
+	};
+
+	struct PackedStructure
+	{
+		typedef Program ProgramType;
+		typedef Grid<PackedStructure> GridType;
+		typedef PackedChunk<PackedStructure> ColumnType;
+		typedef Chunks<PackedStructure> RowType;
+		typedef Cell<PackedStructure> CellType;
+		typedef StandardAllocation Allocation;
+		typedef ScannedExpiry Expiry;
+		enum {ChunkBits=6};
 	};
 
 	inline void GetScreenSize(Display* display,int& width, int& height)
@@ -377,9 +1434,45 @@ cout << "RowRate:" << updaterate << endl;
 		return root;
 	}
 
+	template <typename DS>
+		inline int headless(int argc,char** argv,unsigned long bkcolor)
+	{
+		CmdLine cmdline(argc,argv,"life");
+		const int width(cmdline.exists("-width")?atoi(cmdline["-width"].c_str()):1024);
+		const int height(cmdline.exists("-height")?atoi(cmdline["-height"].c_str()):768);
+		const bool raw(cmdline.exists("-raw"));
+		stringstream except;
+		try
+		{
+			FrameBuffer framebuffer(width,height);
+			framebuffer.Fill(bkcolor,0,0,width,height);
+			GC gc(NULL);
+			typename DS::GridType canvas(NULL,gc,width,height,bkcolor);
+			Headless program(canvas,framebuffer);
+			if (cmdline.exists("-frames")) program.SetFrames(atoi(cmdline["-frames"].c_str()));
+			if (cmdline.exists("-threads")) program.SetThreads(atoi(cmdline["-threads"].c_str()));
+			if (cmdline.exists("-dump-frames")) program.SetDump(cmdline["-dump-frames"],raw);
+			program(argc,argv);
+			if (cmdline.exists("-dump"))
+			{
+				ofstream out(cmdline["-dump"].c_str(),ios::binary);
+				framebuffer.Dump(out,raw);
+			}
+		}
+		catch(runtime_error& e){except<<"runtime error:"<<e.what();}
+		catch(...){except<<"unknown error";}
+		if (!except.str().empty()) { cout<<except.str()<<endl; return -1; }
+		return 0;
+	}
+
 	template <typename DS>
 		inline int x11main(int argc,char** argv,KeyMap& keys,unsigned long bkcolor)
 	{
+		{
+			CmdLine cmdline(argc,argv,"life");
+			if (cmdline.exists("-headless")) return headless<DS>(argc,argv,bkcolor);
+			if (cmdline.exists("-event-thread")) XInitThreads();
+		}
 		XSizeHints displayarea;
 		Display *display;//(XOpenDisplay(""));
 		display = XOpenDisplay (getenv ("DISPLAY"));
@@ -409,7 +1502,7 @@ cout << "RowRate:" << updaterate << endl;
 			gc=(XCreateGC(display,window,0,0));
 			XSetBackground(display,gc,background);
 			XSetForeground(display,gc,foreground);
-			XSelectInput(display,window,ButtonPressMask|KeyPressMask|ExposureMask);
+			XSelectInput(display,window,ButtonPressMask|ButtonReleaseMask|ButtonMotionMask|PointerMotionHintMask|KeyPressMask|ExposureMask);
 			XMapRaised(display,window);
 		} else {
 
@@ -438,6 +1531,15 @@ cout << "RowRate:" << updaterate << endl;
 		{
 			typename DS::GridType canvas(display,gc,displayarea.width, displayarea.height,bkcolor);
 			typename DS::ProgramType program(screen,display,window,gc,NULL,canvas,keys,displayarea.width,displayarea.height);
+			if (cmdline.exists("-tick-rate")) program.SetTickRate(atoi(cmdline["-tick-rate"].c_str()));
+			if (cmdline.exists("-frame-rate")) program.SetFrameRate(atoi(cmdline["-frame-rate"].c_str()));
+			if (cmdline.exists("-max-steps")) program.SetMaxSteps(atoi(cmdline["-max-steps"].c_str()));
+			if (cmdline.exists("-buffers")) program.SetBuffers(atoi(cmdline["-buffers"].c_str()));
+			if (cmdline.exists("-shm")) program.SetShared(true,bkcolor);
+			if (cmdline.exists("-hud")) program.SetHud(true);
+			if (cmdline.exists("-threads")) program.SetThreads(atoi(cmdline["-threads"].c_str()));
+			if (cmdline.exists("-event-thread")) program.SetEventThread(true);
+			if (cmdline.exists("-profile")) program.SetProfile(cmdline["-profile"],cmdline.exists("-profile-every")?atoi(cmdline["-profile-every"].c_str()):0);
 			program(argc,argv);
 		}
 		catch(runtime_error& e){except<<"runtime error:"<<e.what();}
@@ -455,10 +1557,12 @@ cout << "RowRate:" << updaterate << endl;
 	{
 		ProximityRectangle() : x(0), y(0), proxi(false),discard(false) {} 
 		ProximityRectangle(const int _x,const int _y) : x(_x), y(_y), proxi(true),discard(false) {}
+		ProximityRectangle(const int ulx,const int uly,const int brx,const int bry) 
+			: x(ulx), y(uly), X11Methods::Rect(ulx,uly,brx,bry), proxi(false),discard(false) {}
 		ProximityRectangle(const int _x,const int _y,const int ulx,const int uly,const int brx,const int bry) 
 			: x(_x), y(_y), X11Methods::Rect(ulx,uly,brx,bry), proxi(false),discard(false) {}
 		ProximityRectangle(const ProximityRectangle& a) : x(a.x),y(a.y), X11Methods::Rect(a),proxi(false),discard(false) {}
-		ProximityRectangle& operator=(const ProximityRectangle& a) { x=a.x; y=a.y; X11Methods::Rect::operator=(a);proxi=false;discard=false; }
+		ProximityRectangle& operator=(const ProximityRectangle& a) { x=a.x; y=a.y; X11Methods::Rect::operator=(a);proxi=false;discard=false; return *this; }
 		virtual ~ProximityRectangle() { for (vector<Rect*>::iterator it=subs.begin();it!=subs.end();it++) delete (*it); }
 		void operator()(const ProximityRectangle& e) 
 		{ 
@@ -472,53 +1576,26 @@ cout << "RowRate:" << updaterate << endl;
 		void zero() { first.first=first.second=0; second.first=second.second=100; }
 		virtual operator XPoint& ()
 		{
-			if (xpoints) delete[] xpoints;
-			xpoints=new XPoint[4];	
-			ProximityRectangle r(*this);
-			if (!subs.empty()) 
+			Point ul(first), br(second);
+			for (vector<Rect*>::iterator it=subs.begin();it!=subs.end();it++)
 			{
-				for (vector<Rect*>::iterator it=subs.begin();it!=subs.end();it++)
-				{
-					Rect& e(**it);
-					if (e.first.first<r.first.first) r.first.first=e.first.first;
-					if (e.first.second<r.first.second) r.first.second=e.first.second;
-					if (e.second.first>r.second.first) r.second.first=e.second.first;
-					if (e.second.second>r.second.second) r.second.second=e.second.second;
-				}
+				Rect& e(**it);
+				if (e.first.first<ul.first) ul.first=e.first.first;
+				if (e.first.second<ul.second) ul.second=e.first.second;
+				if (e.second.first>br.first) br.first=e.second.first;
+				if (e.second.second>br.second) br.second=e.second.second;
 			}
-			xpoints[0].x=r.first.first;
-			xpoints[0].y=r.first.second;
-			xpoints[1].x=r.second.first;
-			xpoints[1].y=r.first.second;
-			xpoints[2].x=r.second.first;
-			xpoints[2].y=r.second.second;
-			xpoints[3].x=r.first.first;
-			xpoints[3].y=r.second.second;
-//cout<<"P:"<<r.first<<"x"<<r.second<<endl;
-			return *xpoints;
+			return points(ul.first,ul.second,br.first,br.second);
 		}
 
-		bool lessthan(ProximityRectangle& p)  
-		{
-			if ( !proxi ) return X11Methods::Rect::operator<(p); //const_cast<ProximityRectangle&>(p));
-			if(x<p.x) return true;
-			if (y<p.y) return true;
-			return false;
-		}
-		operator const vector<Point>& () const
+		bool lessthan(const ProximityRectangle& p) const
 		{
-				neighbors.push_back(Point(x-1,y));
-				neighbors.push_back(Point(x-1,y+1));
-				neighbors.push_back(Point(x-1,y-1));
-				neighbors.push_back(Point(x+1,y));
-				neighbors.push_back(Point(x+1,y+1));
-				neighbors.push_back(Point(x+1,y-1));
-				neighbors.push_back(Point(x,y+1));
-				neighbors.push_back(Point(x,y-1));
-				return neighbors;
+			if (first.first!=p.first.first) return first.first<p.first.first;
+			if (first.second!=p.first.second) return first.second<p.first.second;
+			if (second.first!=p.second.first) return second.first<p.second.first;
+			return second.second<p.second.second;
 		}
 		private:
-		mutable vector<Point> neighbors;
 		int x,y;
 		bool proxi;
 		mutable bool discard;
@@ -526,7 +1603,7 @@ cout << "RowRate:" << updaterate << endl;
 	};
 	inline bool operator<(const ProximityRectangle& a,const ProximityRectangle& b)
 	{
-		return const_cast<ProximityRectangle&>(b).lessthan(const_cast<ProximityRectangle&>(a));
+		return a.lessthan(b);
 	}
 
 	struct InvalidGrid : InvalidArea<ProximityRectangle>
@@ -535,11 +1612,6 @@ cout << "RowRate:" << updaterate << endl;
 		void insert(const int x,const int y,ProximityRectangle r) { X11Methods::InvalidArea<ProximityRectangle>::insert(r); }
 		private:
 		unsigned long color;
-		iterator find(const Point& p) 
-		{ 
-			ProximityRectangle tmp(p.first,p.second);
-			return set<ProximityRectangle>::find(tmp);
-		}
 		//virtual void Show(Display* display,Pixmap& bitmap,Window& window,GC& gc) { return; }
 		virtual void expose() 
 		{
@@ -547,26 +1619,7 @@ cout << "RowRate:" << updaterate << endl;
 			ProximityRectangle i(0,0,0,0,1024,768);//(x-(CW/2)),(y-(CH/2)),(x+(CW/2)),(y+(CH/2)));	
 			insert(0,0,i);
 		}
-		virtual void reduce()
-		{
-			vector<ProximityRectangle> killset;
-			for (iterator it=begin();it!=end();it++)
-			{
-				ProximityRectangle& r(const_cast<ProximityRectangle&>(*it));
-				const vector<Point>& p(r);;
-				for (vector<Point>::const_iterator rit=p.begin();rit!=p.end();rit++)
-				{
-					const Point& P(*rit);
-					iterator found(find(P));
-					if (found!=it)
-						if (found!=end()) 
-						{ 
-							r(*found);
-							erase(found);
-						}
-				}
-			}
-		}
+		virtual void reduce() { X11Methods::InvalidArea<ProximityRectangle>::reduce(); }
 	};
 
 
@@ -575,24 +1628,26 @@ cout << "RowRate:" << updaterate << endl;
 	{
 		friend struct TestPatternGenerator;
 		static PatternBase* generate(const int w,const int h);
+		static PatternBase* generate(const int w,const int h,const int which);
 		protected:
 		PatternBase(){}
+		virtual ~PatternBase() {}
 		virtual void operator()(const int x,const int y) = 0;
-		void push(const double x,const double y){push_back(make_pair<double,double>(x,y));}
+		void push(const double x,const double y){push_back(make_pair(x,y));}
 	};
 
 	struct TestPatternGenerator 
 	{
-		TestPatternGenerator(const int _w,const int _h) : w(_w),h(_h),p(NULL) {}
+		TestPatternGenerator(const int _w,const int _h,const int _which=-1) : w(_w),h(_h),which(_which),p(NULL) {}
 		virtual ~TestPatternGenerator() {if (p) delete p;}
 		operator PatternBase& ()
 		{
 			if (p) delete p;
-			p=PatternBase::generate(w,h);
+			p=(which<0)?PatternBase::generate(w,h):PatternBase::generate(w,h,which);
 			return *p;
 		}
 		private:
-		const int w,h;
+		const int w,h,which;
 		PatternBase* p;
 	};
 
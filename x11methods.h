@@ -54,41 +54,130 @@ namespace X11Methods
 
 	struct Rect : pair<Point,Point>
 	{
-		Rect() : xpoints(NULL) {}
+		Rect() {}
 		Rect(const int ulx,const int uly,const int brx,const int bry) 
-			: pair<Point,Point>(make_pair<Point,Point>(Point(ulx,uly),Point(brx,bry))),xpoints(NULL) { }
-		Rect(const Rect& a) : pair<Point,Point>(a),xpoints(NULL) {}
-		virtual Rect& operator=(const Rect& a) { pair<Point,Point>::operator=(a); /* don't copy points */ }
-		virtual ~Rect() { if (xpoints) delete xpoints; }
+			: pair<Point,Point>(make_pair<Point,Point>(Point(ulx,uly),Point(brx,bry))) { }
+		Rect(const Rect& a) : pair<Point,Point>(a) {}
+		virtual Rect& operator=(const Rect& a) { pair<Point,Point>::operator=(a); /* don't copy points */ return *this; }
+		virtual ~Rect() {}
 		friend ostream& operator<<(ostream&,const Rect&);
 		virtual ostream& operator<<(ostream& o) const { o<<first<<"/"<<second; return o;}
 		void clear(){first.clear();second.clear();}
-		bool operator<(const Rect& r)
-		{
-			if (first<r.first) return true;
-			if (second<r.second) return true;
-			return false;
-		}
-		virtual operator XPoint& () 
-		{
-			if (xpoints) delete[] xpoints;
-			xpoints=new XPoint[4];	
-			xpoints[0].x=first.first;
-			xpoints[0].y=first.second;
-			xpoints[1].x=second.first;
-			xpoints[1].y=first.second;
-			xpoints[2].x=second.first;
-			xpoints[2].y=second.second;
-			xpoints[3].x=first.first;
-			xpoints[3].y=second.second;
-			return *xpoints;
+		bool operator<(const Rect& r) const
+		{
+			if (first.first!=r.first.first) return first.first<r.first.first;
+			if (first.second!=r.first.second) return first.second<r.first.second;
+			if (second.first!=r.second.first) return second.first<r.second.first;
+			return second.second<r.second.second;
 		}
+		virtual operator XPoint& () { return points(first.first,first.second,second.first,second.second); }
 		protected:
-		mutable XPoint* xpoints;
+		XPoint& points(const int ulx,const int uly,const int brx,const int bry)
+		{
+			xpoints[0].x=ulx; xpoints[0].y=uly;
+			xpoints[1].x=brx; xpoints[1].y=uly;
+			xpoints[2].x=brx; xpoints[2].y=bry;
+			xpoints[3].x=ulx; xpoints[3].y=bry;
+			return *xpoints;
+		}
+		XPoint xpoints[4];
 	};
 	inline ostream& operator<<(ostream& o,const Rect& b){return b.operator<<(o);}
 
 
+	struct Extent
+	{
+		Extent() : x1(0),y1(0),x2(0),y2(0) {}
+		Extent(const int _x1,const int _y1,const int _x2,const int _y2) : x1(_x1),y1(_y1),x2(_x2),y2(_y2) {}
+		long long area() const { return static_cast<long long>(x2-x1)*(y2-y1); }
+		Extent operator|(const Extent& e) const 
+			{ return Extent(min(x1,e.x1),min(y1,e.y1),max(x2,e.x2),max(y2,e.y2)); }
+		long long operator&(const Extent& e) const
+		{
+			const int w(min(x2,e.x2)-max(x1,e.x1)), h(min(y2,e.y2)-max(y1,e.y1));
+			return ((w>0) && (h>0))?(static_cast<long long>(w)*h):0;
+		}
+		bool operator==(const Extent& e) const { return (x1==e.x1) && (y1==e.y1) && (x2==e.x2) && (y2==e.y2); }
+		bool operator>=(const Extent& e) const { return (x1<=e.x1) && (y1<=e.y1) && (x2>=e.x2) && (y2>=e.y2); }
+		int minus(const Extent& e,Extent* pieces) const
+		{
+			if (!((*this)&e)) { pieces[0]=*this; return 1; }
+			int n(0);
+			const int top(max(y1,e.y1)), bottom(min(y2,e.y2));
+			if (e.y1>y1) pieces[n++]=Extent(x1,y1,x2,e.y1);
+			if (e.y2<y2) pieces[n++]=Extent(x1,e.y2,x2,y2);
+			if (e.x1>x1) pieces[n++]=Extent(x1,top,e.x1,bottom);
+			if (e.x2<x2) pieces[n++]=Extent(e.x2,top,x2,bottom);
+			return n;
+		}
+		int x1,y1,x2,y2;
+	};
+
+	class Coalesce
+	{
+		public:
+		Coalesce() : overdraw(25),bits(6),query(0) {}
+		void SetOverdraw(const int percent) { if (percent>=0) overdraw=percent; }
+		void operator()(vector<Extent>& rects)
+		{
+			if (rects.size()<2) return;
+			for (tr1::unordered_map<long long,vector<int> >::iterator it=buckets.begin();it!=buckets.end();it++) it->second.clear();
+			alive.assign(rects.size(),true);
+			stamps.assign(rects.size(),0);
+			for (size_t i=0;i<rects.size();i++) place(i,rects[i]);
+			for (size_t i=0;i<rects.size();i++)
+			{
+				if (!alive[i]) continue;
+				bool merged(true);
+				while (merged)
+				{
+					merged=false;
+					candidates(i,rects[i]);
+					for (vector<int>::iterator it=found.begin();it!=found.end();it++)
+					{
+						const int j(*it);
+						if (!alive[j]) continue;
+						const Extent u(rects[i]|rects[j]);
+						const long long covered(rects[i].area()+rects[j].area()-(rects[i]&rects[j]));
+						if (((u.area()-covered)*100)>(u.area()*overdraw)) continue;
+						rects[i]=u; alive[j]=false; merged=true;
+					}
+					if (merged) place(i,rects[i]);
+				}
+			}
+			size_t n(0);
+			for (size_t i=0;i<rects.size();i++) if (alive[i]) rects[n++]=rects[i];
+			rects.resize(n);
+		}
+		private:
+		int overdraw,bits;
+		int query;
+		tr1::unordered_map<long long,vector<int> > buckets;
+		vector<bool> alive;
+		vector<int> stamps,found;
+		static long long Key(const int bx,const int by) 
+			{ return (static_cast<long long>(bx)<<32)^static_cast<unsigned int>(by); }
+		void place(const int i,const Extent& e)
+		{
+			for (int bx=(e.x1>>bits);bx<=(e.x2>>bits);bx++)
+				for (int by=(e.y1>>bits);by<=(e.y2>>bits);by++)
+					buckets[Key(bx,by)].push_back(i);
+		}
+		void candidates(const int i,const Extent& e)
+		{
+			found.clear();
+			stamps[i]=++query;
+			for (int bx=((e.x1-1)>>bits);bx<=((e.x2+1)>>bits);bx++)
+				for (int by=((e.y1-1)>>bits);by<=((e.y2+1)>>bits);by++)
+				{
+					tr1::unordered_map<long long,vector<int> >::iterator b(buckets.find(Key(bx,by)));
+					if (b==buckets.end()) continue;
+					for (vector<int>::iterator it=b->second.begin();it!=b->second.end();it++)
+						if ((stamps[*it]!=query) && (alive[*it])) { stamps[*it]=query; found.push_back(*it); }
+				}
+		}
+	};
+
 	struct InvalidBase
 	{
 		InvalidBase() : trace(false) {}
@@ -97,37 +186,52 @@ namespace X11Methods
 			{ if (trace) Trace(display,bitmap,window,gc,0XFF); }
 		virtual void Trace(Display* display,Pixmap& bitmap,Window& window,GC& gc,const unsigned long) = 0;
 		virtual void Draw(Display*,Pixmap&,Window&,GC&) = 0;
+		virtual void Draw(Backend&,Backend&) = 0;
+		virtual void Collect(vector<XRectangle>&) = 0;
 		virtual void reduce() = 0;
+		virtual void insert(const int ulx,const int uly,const int brx,const int bry) {}
 		virtual void expose() {}
 		virtual void clear() = 0;
 		void SetTrace(bool t){trace=t;}
 		protected: bool trace;
 	};
 
-	template <typename R>
-		struct InvalidArea : InvalidBase, set<R>
+	template <typename R,typename A=allocator<R> >
+		struct InvalidArea : InvalidBase, set<R,less<R>,A>
 	{
-		virtual void clear() { set<R>::clear(); }
-		virtual void insert(R r) {set<R>::insert(r); }
+		typedef set<R,less<R>,A> Rects;
+		virtual void clear() { Rects::clear(); }
+		virtual void insert(R r) {Rects::insert(r); }
+		virtual void insert(const int ulx,const int uly,const int brx,const int bry) { insert(R(ulx,uly,brx,bry)); }
 		virtual void expand(R r) 
 		{
-			if (this->empty()) {set<R>::insert(r);  return;}
-			typename set<R>::reverse_iterator last(this->rbegin());
+			if (this->empty()) {Rects::insert(r);  return;}
+			typename Rects::reverse_iterator last(this->rbegin());
 			if (this->size()>1) throw string("Cannot expand an invalid area with more than one entry");
 			const R& e(*last);
 			if (r.first.first>e.first.first) r.first.first=e.first.first;
 			if (r.first.second>e.first.second) r.first.second=e.first.second;
 			if (r.second.first<e.second.first) r.second.first=e.second.first;
 			if (r.second.second<e.second.second) r.second.second=e.second.second;
-			erase(e); insert(r); 
+			this->erase(e); insert(r); 
 		}
-		virtual void reduce() { }
+		virtual void reduce() 
+		{ 
+			if (this->size()<2) return;
+			extents.clear();
+			for (typename Rects::iterator it=this->begin();it!=this->end();it++)
+				extents.push_back(Extent(it->first.first,it->first.second,it->second.first,it->second.second));
+			coalesce(extents);
+			Rects::clear();
+			for (vector<Extent>::iterator it=extents.begin();it!=extents.end();it++)
+				Rects::insert(R(it->x1,it->y1,it->x2,it->y2));
+		}
+		void SetOverdraw(const int percent) { coalesce.SetOverdraw(percent); }
 		virtual void Draw(Display* display,Pixmap& bitmap,Window& window,GC& gc) 
 		{
-			for (typename set<R>::iterator it=this->begin();it!=this->end();it++)
+			for (typename Rects::iterator it=this->begin();it!=this->end();it++)
 			{
-				R& r(const_cast<R&>(*it));
-				XPoint& points(r);
+				const R& r(*it);
 				int x(r.first.first);
 				int y(r.first.second);
 				int w(r.second.first-x);
@@ -135,14 +239,34 @@ namespace X11Methods
 				XCopyArea(display,bitmap,window,gc,x,y,w,h,x,y); 
 			}
 		}
+		virtual void Draw(Backend& source,Backend& target) 
+		{
+			for (typename Rects::iterator it=this->begin();it!=this->end();it++)
+			{
+				const R& r(*it);
+				const int x(r.first.first), y(r.first.second);
+				target.Copy(source,x,y,r.second.first-x,r.second.second-y,x,y);
+			}
+		}
+
+		virtual void Collect(vector<XRectangle>& rects)
+		{
+			for (typename Rects::iterator it=this->begin();it!=this->end();it++)
+			{
+				const R& r(*it);
+				XRectangle x; 
+				x.x=r.first.first; x.y=r.first.second;
+				x.width=r.second.first-r.first.first; x.height=r.second.second-r.first.second;
+				rects.push_back(x);
+			}
+		}
 
 		virtual void Fill(Display* display,Pixmap& bitmap,GC& gc)
 		{
 			XSetForeground(display,gc,0XFFFF);
-			for (typename set<R>::iterator it=this->begin();it!=this->end();it++)
+			for (typename Rects::iterator it=this->begin();it!=this->end();it++)
 			{
-				R& r(const_cast<R&>(*it));
-				XPoint& points(r);
+				const R& r(*it);
 				int x(r.first.first-1);
 				int y(r.first.second-1);
 				int w(r.second.first-x+2);
@@ -152,7 +276,7 @@ namespace X11Methods
 		}
 		virtual void Trace(Display* display,Pixmap& bitmap,Window& window,GC& gc,unsigned long color)
 		{
-			for (typename set<R>::iterator it=this->begin();it!=this->end();it++)
+			for (typename Rects::iterator it=this->begin();it!=this->end();it++)
 			{
 				color<<=4; if (color==0) color=0XFF;
 				XSetForeground(display,gc,color);
@@ -167,59 +291,395 @@ namespace X11Methods
 				XCopyArea(display,bitmap,window,gc,x,y,w,h,x,y); 
 			}
 		}
+		protected:
+		Coalesce coalesce;
+		vector<Extent> extents;
+	};
+
+	struct XBackend : Backend
+	{
+		XBackend(Display* _display,Drawable _drawable,GC& _gc) : display(_display),drawable(_drawable),gc(_gc) {}
+		virtual void Fill(const unsigned long color,XRectangle* rects,const int n)
+			{ XSetForeground(display,gc,color); XFillRectangles(display,drawable,gc,rects,n); }
+		virtual void Polygon(const unsigned long color,XPoint* points,const int n)
+			{ XSetForeground(display,gc,color); XFillPolygon(display,drawable,gc,points,n,Complex,CoordModeOrigin); }
+		virtual void Lines(const unsigned long color,XPoint* points,const int n)
+			{ XSetForeground(display,gc,color); XDrawLines(display,drawable,gc,points,n,CoordModeOrigin); }
+		virtual void Segments(const unsigned long color,XSegment* segments,const int n)
+			{ XSetForeground(display,gc,color); XDrawSegments(display,drawable,gc,segments,n); }
+		virtual void Text(const unsigned long color,const int x,const int y,const string& text)
+			{ XSetForeground(display,gc,color); XDrawString(display,drawable,gc,x,y,text.c_str(),text.size()); }
+		virtual void Copy(Backend& source,const int sx,const int sy,const int w,const int h,const int dx,const int dy)
+			{ XCopyArea(display,dynamic_cast<XBackend&>(source).drawable,drawable,gc,sx,sy,w,h,dx,dy); }
+		private:
+		Display* display;
+		Drawable drawable;
+		GC& gc;
+	};
+
+	struct PixmapAtlas : Atlas
+	{
+		PixmapAtlas(const int size=1024) : Atlas(size),display(NULL),sheet(0),gc(NULL) {}
+		virtual ~PixmapAtlas() { release(); }
+		void SetSize(const int n) { release(); placed.clear(); shelves.SetSize(n); }
+		void operator()(Display* _display,Drawable target,GC& _gc,const Sprite& sprite,const pair<int,int>* at,const int n)
+		{
+			if (!sheet) { display=_display; drawable=target; }
+			gc=&_gc;
+			pair<int,int> p;
+			if (!locate(sprite,p))
+			{
+				XBackend backend(_display,target,_gc);
+				for (int i=0;i<n;i++) sprite.Draw(backend,at[i].first,at[i].second);
+				return;
+			}
+			for (int i=0;i<n;i++)
+				XCopyArea(display,sheet,target,_gc,p.first,p.second,sprite.width,sprite.height,at[i].first,at[i].second);
+		}
+		protected:
+		virtual void render(const Sprite& sprite,const pair<int,int>& at)
+		{
+			if (!sheet) sheet=XCreatePixmap(display,drawable,Size(),Size(),DefaultDepth(display,DefaultScreen(display)));
+			XBackend backend(display,sheet,*gc);
+			sprite.Draw(backend,at.first,at.second);
+		}
+		private:
+		Display* display;
+		Drawable drawable;
+		Pixmap sheet;
+		GC* gc;
+		void release() { if (sheet) XFreePixmap(display,sheet); sheet=0; }
+		PixmapAtlas(const PixmapAtlas&);
+		void operator=(const PixmapAtlas&);
+	};
+
+	struct Batch
+	{
+		// primitives replay in submission order; only consecutive ones of the same kind and color share a request.
+		// inside a layer, fills and segments are kept per color instead, and the layer lands
+		// in order as one request per color when it closes
+		Batch() : layered(false) {}
+		void Layer(const bool on) { close(); layered=on; }
+		void Fill(const unsigned long color,const int x,const int y,const int w,const int h)
+		{
+			XRectangle r; r.x=x; r.y=y; r.width=w; r.height=h;
+			if (layered) { fills[color].push_back(r); return; }
+			extend(Fills,color,NULL,rects.size());
+			rects.push_back(r);
+		}
+		void Segment(const unsigned long color,const int x1,const int y1,const int x2,const int y2)
+		{
+			XSegment s; s.x1=x1; s.y1=y1; s.x2=x2; s.y2=y2;
+			if (layered) { strokes[color].push_back(s); return; }
+			extend(Segments,color,NULL,segments.size());
+			segments.push_back(s);
+		}
+		void Text(const unsigned long color,const int x,const int y,const string& text)
+			{ extend(Texts,color,NULL,texts.size()); texts.push_back(make_pair(Point(x,y),text)); }
+		void Label(const unsigned long fg,const unsigned long bg,const int x,const int y,const string& text)
+			{ commands.push_back(Command(Labels,0,NULL,labels.size())); labels.push_back(make_pair(Point(x,y),LabelKey(text,fg,bg))); }
+		void Stamp(const Sprite& sprite,const int x,const int y) 
+			{ extend(Sprites,0,&sprite,stamps.size()); stamps.push_back(make_pair(x,y)); }
+		void SetTextCache(const size_t bytes) { pixmaps.SetCapacity(bytes); rasters.SetCapacity(bytes); }
+		void SetAtlas(const int size) { pixmapatlas.SetSize(size); rasteratlas.SetSize(size); }
+		void Flush(Display* display,Pixmap& bitmap,GC& gc)
+		{
+			close();
+			XBackend backend(display,bitmap,gc);
+			for (vector<Command>::iterator it=commands.begin();it!=commands.end();it++)
+				switch (it->kind)
+				{
+					case Sprites: pixmapatlas(display,bitmap,gc,*it->sprite,&stamps[it->first],it->count); break;
+					case Labels: pixmaps(display,bitmap,gc,labels[it->first].second,labels[it->first].first.first,labels[it->first].first.second); break;
+					default: Draw(backend,*it);
+				}
+			clear();
+		}
+		void Flush(Backend& backend)
+		{
+			close();
+			for (vector<Command>::iterator it=commands.begin();it!=commands.end();it++)
+				switch (it->kind)
+				{
+					case Sprites: rasteratlas(backend,*it->sprite,&stamps[it->first],it->count); break;
+					case Labels: rasters(backend,labels[it->first].second,labels[it->first].first.first,labels[it->first].first.second); break;
+					default: Draw(backend,*it);
+				}
+			clear();
+		}
+		private:
+		enum Kind {Fills,Segments,Texts,Labels,Sprites};
+		struct Command
+		{
+			Command(const Kind _kind,const unsigned long _color,const Sprite* _sprite,const size_t _first) 
+				: kind(_kind),color(_color),sprite(_sprite),first(_first),count(1) {}
+			Kind kind;
+			unsigned long color;
+			const Sprite* sprite;
+			size_t first;
+			int count;
+		};
+		void extend(const Kind kind,const unsigned long color,const Sprite* sprite,const size_t first)
+		{
+			if (!commands.empty())
+			{
+				Command& last(commands.back());
+				if ((last.kind==kind) && (last.color==color) && (last.sprite==sprite)) { last.count++; return; }
+			}
+			commands.push_back(Command(kind,color,sprite,first));
+		}
+		void close()
+		{
+			for (FillColors::iterator it=fills.begin();it!=fills.end();)
+			{
+				if (it->second.empty()) { fills.erase(it++); continue; }
+				commands.push_back(Command(Fills,it->first,NULL,rects.size()));
+				commands.back().count=it->second.size();
+				rects.insert(rects.end(),it->second.begin(),it->second.end());
+				it->second.clear(); it++;
+			}
+			for (StrokeColors::iterator it=strokes.begin();it!=strokes.end();)
+			{
+				if (it->second.empty()) { strokes.erase(it++); continue; }
+				commands.push_back(Command(Segments,it->first,NULL,segments.size()));
+				commands.back().count=it->second.size();
+				segments.insert(segments.end(),it->second.begin(),it->second.end());
+				it->second.clear(); it++;
+			}
+		}
+		void Draw(Backend& backend,const Command& c)
+		{
+			switch (c.kind)
+			{
+				case Fills: backend.Fill(c.color,&rects[c.first],c.count); break;
+				case Segments: backend.Segments(c.color,&segments[c.first],c.count); break;
+				case Texts: 
+					for (size_t i=c.first;i<c.first+c.count;i++) backend.Text(c.color,texts[i].first.first,texts[i].first.second,texts[i].second);
+					break;
+				default: break;
+			}
+		}
+		void clear() { commands.clear(); rects.clear(); segments.clear(); texts.clear(); labels.clear(); stamps.clear(); }
+		typedef map<unsigned long,vector<XRectangle> > FillColors;
+		typedef map<unsigned long,vector<XSegment> > StrokeColors;
+		bool layered;
+		FillColors fills;
+		StrokeColors strokes;
+		vector<Command> commands;
+		vector<XRectangle> rects;
+		vector<XSegment> segments;
+		vector<pair<Point,string> > texts;
+		vector<pair<Point,LabelKey> > labels;
+		vector<pair<int,int> > stamps;
+		PixmapLabels pixmaps;
+		RasterLabels rasters;
+		PixmapAtlas pixmapatlas;
+		RasterAtlas rasteratlas;
 	};
 
 	class Canvas 
 	{
 		friend class Application;
+		friend class Headless;
 		public:
 		virtual void operator()(ApplicationBase&,int argc,char** argv) {}
 		Canvas(Display* _display,GC& _gc,const int _ScreenWidth, const int _ScreenHeight)
-			: display(_display),gc(_gc),ScreenWidth(_ScreenWidth),ScreenHeight(_ScreenHeight) { }
+			: display(_display),gc(_gc),ScreenWidth(_ScreenWidth),ScreenHeight(_ScreenHeight),framebuffer(NULL),profiler(NULL),pool(NULL) { }
 		virtual bool operator()(XEvent&,KeyMap&) //{cout<<"Event:"<<endl; cout.flush(); return true;}
 			{return true;}
 		virtual bool operator()(KeyMap&) {return true;}
 		virtual void operator()(Pixmap& bitmap) = 0;
 		virtual void update() = 0; 
+		virtual bool damaged() { return true; }
+		virtual void expose() {}
+		virtual void expose(const int x,const int y,const int w,const int h) {}
 		virtual operator InvalidBase& () = 0;
 		protected:
 		Display* display;
 		GC& gc;
 		const int ScreenWidth,ScreenHeight;
+		FrameBuffer* framebuffer;
+		Profiler* profiler;
+		Pool* pool;
 		private:
 	};
 
 	class Buffer 
 	{
 		friend class Application;
-		Buffer(const int _screen,Display* _display,Window& window,GC& _gc,Canvas& _canvas,XImage* _image,const int _ScreenWidth,const int _ScreenHeight)
-			: screen(_screen),display(_display),gc(_gc),image(_image),ScreenWidth(_ScreenWidth),ScreenHeight(_ScreenHeight),
+		Buffer(const int _screen,Display* _display,Window& window,GC& _gc,Canvas& _canvas,const int _ScreenWidth,const int _ScreenHeight)
+			: screen(_screen),display(_display),gc(_gc),ScreenWidth(_ScreenWidth),ScreenHeight(_ScreenHeight),
 			bitmap(XCreatePixmap(_display,window,_ScreenWidth,_ScreenHeight,DefaultDepth(_display, DefaultScreen(_display)))),canvas(_canvas) { }
 		~Buffer() { XFreePixmap(display,bitmap); }
 		Pixmap bitmap;
+		vector<XRectangle> stale;
 		const int screen;
 		Display* display;
 		GC& gc;
 		Canvas& canvas;
-		XImage* image;
 		const int ScreenWidth,ScreenHeight;
-		public: operator Pixmap& ()
+		void operator()(Pixmap& source,const vector<XRectangle>& rects)
+		{
+			for (vector<XRectangle>::const_iterator it=rects.begin();it!=rects.end();it++)
+				XCopyArea(display,source,bitmap,gc,it->x,it->y,it->width,it->height,it->x,it->y);
+		}
+		public: operator Pixmap& () { return bitmap; }
+	};
+
+	inline long long when(const long long offset=0)
+	{
+		struct timespec tp;
+		clock_gettime(CLOCK_MONOTONIC,&tp);
+		return ((tp.tv_sec*1000000000LL)+tp.tv_nsec)-offset;
+	}
+
+	class Scheduler
+	{
+		public:
+		enum {Events=1,Tick=2,Frame=4};
+		Scheduler() : connection(-1),timer(-1),tick(0),frame(0),maxsteps(1),nexttick(0),nextframe(0),steps(0) {}
+		virtual ~Scheduler() { if (timer>=0) close(timer); }
+		void operator()(const int _connection,const int tickrate,const int framerate,const int _maxsteps)
 		{
-			if (image) 
+			connection=_connection; 
+			tick=1000000000LL/tickrate;
+			frame=(framerate>0)?(1000000000LL/framerate):0;
+			maxsteps=(_maxsteps>0)?_maxsteps:1;
+#ifdef __linux__
+			timer=timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK);
+#endif
+			nexttick=nextframe=when();
+		}
+		int Steps() const { return steps; }
+		int operator()(Display* display) { return (*this)(XPending(display)!=0); }
+		int operator()(const bool pending)
+		{
+			int ready(pending?Events:0);
+			const long long deadline(((frame) && (nextframe<nexttick))?nextframe:nexttick);
+			struct pollfd fds[2];
+			int n(0);
+			fds[n].fd=connection; fds[n].events=POLLIN; fds[n++].revents=0;
+			int timeout(0);
+			if (!ready)
 			{
-				int x(0); int y(0); const int w(image->width); const int h(image->height);
-				const int i((ScreenWidth/w)+1);
-				const int j((ScreenHeight/h)+1);
-				for (int ii=0;ii<i;ii++)
-					for (int jj=0;jj<j;jj++)
-						{ x=ii*w; y=jj*h; XPutImage(display,bitmap,gc,image,0,0,x,y,w,h); }
-//			} else {
-//				XSetForeground(display,gc,0XFFFFFF);
-//				InvalidBase& invalid(canvas);
-//				invalid.Fill(display,bitmap,gc);
+				const long long remaining(deadline-when());
+				if (remaining>0)
+				{
+					timeout=(remaining+999999)/1000000;
+#ifdef __linux__
+					if (timer>=0)
+					{
+						struct itimerspec spec;
+						spec.it_interval.tv_sec=spec.it_interval.tv_nsec=0;
+						spec.it_value.tv_sec=deadline/1000000000LL;
+						spec.it_value.tv_nsec=deadline%1000000000LL;
+						if (!timerfd_settime(timer,TFD_TIMER_ABSTIME,&spec,NULL))
+							{ fds[n].fd=timer; fds[n].events=POLLIN; fds[n++].revents=0; timeout=-1; }
+					}
+#endif
+				}
 			}
-			return bitmap;
+			if (poll(fds,n,timeout)>0) 
+			{
+				if (fds[0].revents&POLLIN) ready|=Events;
+				if ((n>1) && (fds[1].revents&POLLIN)) { unsigned long long expirations; read(timer,&expirations,sizeof(expirations)); }
+			}
+			const long long now(when());
+			steps=0;
+			while ((now>=nexttick) && (steps<maxsteps)) { steps++; nexttick+=tick; }
+			if (now>=nexttick) nexttick=now+tick;
+			if (steps) ready|=Tick;
+			if (!frame) { if (ready) ready|=Frame; }
+			else if (now>=nextframe) 
+			{
+				ready|=Frame;
+				nextframe+=frame;
+				if (nextframe<=now) nextframe=now+frame;
+			}
+			return ready;
 		}
+		private:
+		int connection,timer;
+		long long tick,frame;
+		int maxsteps;
+		long long nexttick,nextframe;
+		int steps;
+	};
+
+	class EventThread
+	{
+		public:
+		EventThread(Display* _display,Window _window,FrameBuffer* _framebuffer=NULL) 
+			: display(_display),window(_window),framebuffer(_framebuffer),stopping(false),running(false),
+			stop(XInternAtom(_display,"X11GRID_EVENT_THREAD_STOP",False))
+		{
+			wake[0]=wake[1]=-1;
+			if (pipe(wake)) return;
+			fcntl(wake[0],F_SETFL,O_NONBLOCK);
+			fcntl(wake[1],F_SETFL,O_NONBLOCK);
+			running=!pthread_create(&thread,NULL,reading,this);
+			// this thread now owns the queue, so it is the one to see the framebuffer's completions
+			if ((running) && (framebuffer)) framebuffer->SetForwarded(true);
+		}
+		virtual ~EventThread()
+		{
+			if (running)
+			{
+				stopping=true;
+				XEvent e; memset(&e,0,sizeof(e));
+				e.xclient.type=ClientMessage; e.xclient.window=window;
+				e.xclient.message_type=stop; e.xclient.format=32;
+				XSendEvent(display,window,False,NoEventMask,&e);
+				XFlush(display);
+				pthread_join(thread,NULL);
+				if (framebuffer) framebuffer->SetForwarded(false);
+			}
+			if (wake[0]>=0) close(wake[0]);
+			if (wake[1]>=0) close(wake[1]);
+		}
+		operator bool () const { return running; }
+		int Fd() const { return wake[0]; }
+		bool Pending() const { return !events.empty(); }
+		bool operator()(XEvent& e)
+		{
+			char drain[64];
+			while (read(wake[0],drain,sizeof(drain))>0) ;
+			return events.pop(e);
+		}
+		private:
+		Display* display;
+		Window window;
+		FrameBuffer* framebuffer;
+		volatile bool stopping;
+		bool running;
+		const Atom stop;
+		int wake[2];
+		pthread_t thread;
+		Ring<XEvent,10> events;
+		void push(const XEvent& e)
+		{
+			while ((!events.push(e)) && (!stopping)) usleep(1000);
+			// every push signals; the consumer may have drained and not yet polled,
+			// and a full pipe already has a wakeup pending
+			const char c(0); 
+			write(wake[1],&c,1);
+		}
+		static void* reading(void* p)
+		{
+			EventThread& self(*static_cast<EventThread*>(p));
+			while (!self.stopping)
+			{
+				XEvent e;
+				XNextEvent(self.display,&e);
+				if ((e.type==ClientMessage) && (e.xclient.message_type==self.stop)) continue;
+				if ((self.framebuffer) && (self.framebuffer->Completed(e))) continue;
+				if (e.type==MotionNotify) while (XCheckTypedWindowEvent(self.display,e.xmotion.window,MotionNotify,&e)) ;
+				self.push(e);
+			}
+			return NULL;
+		}
+		EventThread(const EventThread&);
+		void operator=(const EventThread&);
 	};
 
 	class Application ;
@@ -236,35 +696,85 @@ namespace X11Methods
 		operator Display* () { return display;}
 		operator Canvas& () { return canvas; }
 		Application(const int _screen,Display* _display,Window& _window,GC& _gc,XImage* _image,Canvas& _canvas,KeyMap& _keys,const int _ScreenWidth,const int _ScreenHeight)
-			: Focused(true), screen(_screen),display(_display),window(_window),gc(_gc),image(_image),canvas(_canvas),keys(_keys),ScreenWidth(_ScreenWidth),ScreenHeight(_ScreenHeight),buffers(canvas) 
+			: Focused(true),canvas(_canvas),keys(_keys),screen(_screen),display(_display),window(_window),gc(_gc),image(_image),ScreenWidth(_ScreenWidth),ScreenHeight(_ScreenHeight),
+				tickrate(100),framerate(0),maxsteps(5),redraw(true),shared(false),backdrop(0),framebuffer(NULL),
+				profiler(NULL),hud(false),profileevery(100),profileout(NULL),pool(NULL),threaded(false),eventthread(NULL),buffers(canvas)
 		{
 			cursor = XCreateFontCursor(display, XC_arrow);
 		}
+		virtual ~Application() 
+		{ 
+			if (eventthread) delete eventthread;
+			canvas.framebuffer=NULL; if (framebuffer) delete framebuffer; 
+			canvas.profiler=NULL; if (profiler) delete profiler;
+			canvas.pool=NULL; if (pool) delete pool;
+		}
+		void SetTickRate(const int hz) { if (hz>0) tickrate=hz; }
+		void SetFrameRate(const int hz) { if (hz>=0) framerate=hz; }
+		void SetMaxSteps(const int n) { if (n>0) maxsteps=n; }
+		void SetBuffers(const int n) { buffers.SetCount(n); }
+		void SetShared(const bool s,const unsigned long background=0) { shared=s; backdrop=background; }
+		void SetHud(const bool h) { hud=h; if (hud) profiling(); }
+		void SetEventThread(const bool t) { threaded=t; }
+		void SetThreads(const int n)
+		{
+			canvas.pool=NULL; 
+			if (pool) delete pool;
+			pool=(n>1)?new Pool(n):NULL;
+			canvas.pool=pool;
+		}
+		void SetProfile(const string& path,const int every)
+		{
+			profiling();
+			if (every>0) profileevery=every;
+			if (path.empty()) { profileout=&cerr; return; }
+			profilefile.open(path.c_str());
+			profileout=&profilefile;
+		}
 		virtual void operator()(int argc,char** argv)
 		{
-			const long long started(when());
 			buffers(screen,display,window,gc,image,ScreenWidth,ScreenHeight);
-			long long next(0),unext(0);
+			if (shared)
+			{
+				framebuffer=new FrameBuffer(display,ScreenWidth,ScreenHeight,backdrop);
+				if (!*framebuffer) { delete framebuffer; framebuffer=NULL; }
+				canvas.framebuffer=framebuffer;
+			}
+			if (threaded)
+			{
+				eventthread=new EventThread(display,window,framebuffer);
+				if (!*eventthread) { delete eventthread; eventthread=NULL; }
+			}
+			scheduler(eventthread?eventthread->Fd():ConnectionNumber(display),tickrate,framerate,maxsteps);
+			Pixmap* bitmap(NULL);
+			bool frame(true);
 			while (true) 
 			{
-				//if (when(started)>next) 
+				if ((frame) && ((redraw) || (canvas.damaged())))
 				{
 					Buffer& buffer(buffers);
-					Pixmap& bitmap(buffer);
+					bitmap=&static_cast<Pixmap&>(buffer);
 					canvas(*this,argc,argv);
 					if (!display) return;
-					canvas(bitmap);
-					InvalidBase& invalid(canvas);
-					draw(bitmap);
-					if (!events(bitmap)) return ;
-					next=(when(started)+1e2);
+					canvas(*bitmap);
+					if ((profiler) && (hud)) overlay(*bitmap);
+					{ Profile profile(profiler,Profiler::Draw); draw(*bitmap); }
+					{ Profile profile(profiler,Profiler::Flush); XFlush(display); }
+					if (profiler) report();
+					redraw=false;
 				}
-				//if (when(started)>unext) 
+				const int ready(eventthread?scheduler(eventthread->Pending()):scheduler(display));
+				if (ready&Scheduler::Events) 
 				{
+					Profile profile(profiler,Profiler::Events);
+					if (!events(*bitmap)) return ;
+				}
+				for (int step=0;step<scheduler.Steps();step++) 
+				{
+					Profile profile(profiler,Profiler::Update);
 					update();
-					unext=(when(started)+1e2);
 				}
-				usleep(1e2);
+				frame=(ready&Scheduler::Frame);
 			}
 		}
 		protected:
@@ -277,26 +787,36 @@ namespace X11Methods
 			invalid.reduce();
 			invalid.Draw(display,bitmap,window,gc);
 			invalid.Show(display,bitmap,window,gc);
+			buffers.Present(invalid);
 			invalid.clear();
 		}	
+		void overlay(Pixmap& bitmap)
+		{
+			XBackend backend(display,bitmap,gc);
+			(*profiler)(backend);
+			InvalidBase& invalid(canvas);
+			invalid.insert(Profiler::HudX,Profiler::HudY,Profiler::HudX+Profiler::HudWidth,Profiler::HudY+profiler->HudHeight());
+		}
+		void report()
+		{
+			const unsigned long long frames(++(*profiler));
+			if ((profileout) && (!(frames%profileevery))) profiler->Dump(*profileout);
+		}
+		void profiling()
+		{
+			if (profiler) return;
+			profiler=new Profiler;
+			canvas.profiler=profiler;
+		}
 
 		virtual bool events(Pixmap& bitmap,KeyMap& keys) 
 		{ 
 			XEvent& e(keys);
 			if (!e.type) return true;
-			cout<<"Ev>"<<e.type<<"  "<<Expose<<" - ";
-			if (e.type==NoExpose) 
-			{
-				//cout<<"NoExpose"; cout.flush();
-			}
-			if (e.type==GraphicsExpose) 
-			{
-				cout<<"GraphicsExpose"; cout.flush();
-			}
+			X11TraceDebug("event",e.type,e.xany.serial);
 			if (e.type==Expose) 
 			{
 				InvalidBase& invalid(canvas);
-				cout<<"Expose"; cout.flush();
 				invalid.expose();
 			}
 			return true; 
@@ -304,15 +824,39 @@ namespace X11Methods
 
 		virtual bool events(Pixmap& bitmap)
 		{
+			if (eventthread)
+			{
+				XEvent e,motion;
+				bool moved(false);
+				while ((*eventthread)(e))
+				{
+					if (e.type==MotionNotify) { motion=e; moved=true; continue; }
+					if (moved) { moved=false; if (!events(bitmap,motion)) return false; }
+					if (!events(bitmap,e)) return false;
+				}
+				if (moved) return events(bitmap,motion);
+				return true;
+			}
+			while (XPending(display))
+			{
+				XEvent e;
+				XNextEvent(display,&e);
+				if (!events(bitmap,e)) return false;
+			}
+			return true;
+		}
 
-			XWindowAttributes attr;
-			XButtonEvent start;
-			if (!XPending(display)) return true;
-
+		virtual bool events(Pixmap& bitmap,XEvent& e)
+		{
+			if ((framebuffer) && (framebuffer->Completed(e))) return true;
 			bool ret(true);
-			XEvent e;
-			XNextEvent(display,&e);
 			DebugEvent( e );
+			if (e.type==Expose) 
+			{
+				InvalidBase& invalid(canvas);
+				invalid.insert(e.xexpose.x,e.xexpose.y,e.xexpose.x+e.xexpose.width,e.xexpose.y+e.xexpose.height);
+				redraw=true;
+			}
 			keys.clear();
 			if (Focused) 
 			{
@@ -356,46 +900,142 @@ namespace X11Methods
 		}
 
 		protected:
-		const long long when(const long long offset=0)
-		{
-			struct timespec tp;
-			clock_gettime(CLOCK_MONOTONIC,&tp);
-			long long now(tp.tv_sec);
-			if (!offset) return now;
-			now-=offset;
-			now*=1e9;
-			now+=tp.tv_nsec;
-			return now;
-		}
+		const long long when(const long long offset=0) { return X11Methods::when(offset); }
 		const int screen;
 		Display* display;
 		Window& window;
 		GC& gc;
 		XImage* image;
 		const int ScreenWidth,ScreenHeight;
+		int tickrate,framerate,maxsteps;
+		bool redraw,shared;
+		unsigned long backdrop;
+		FrameBuffer* framebuffer;
+		Profiler* profiler;
+		bool hud;
+		int profileevery;
+		ostream* profileout;
+		ofstream profilefile;
+		Pool* pool;
+		bool threaded;
+		EventThread* eventthread;
+		Scheduler scheduler;
 
 		private:
-		class ScreenBuffers : pair<Buffer*,Buffer*>
+		class ScreenBuffers : vector<Buffer*>
 		{
-			bool toggle;
 			public: 
-			ScreenBuffers(Canvas& _canvas) : canvas(_canvas) {}
-			virtual ~ScreenBuffers(){delete first; delete second;}
-			void operator()(const int screen,Display* display,Window& window,GC& gc,XImage* image,const int ScreenWidth,const int ScreenHeight)
+			ScreenBuffers(Canvas& _canvas) : canvas(_canvas),count(2),current(0),back(NULL),front(NULL),display(NULL),gc(NULL),window(0),background(0) {}
+			virtual ~ScreenBuffers()
+			{ 
+				for (iterator it=begin();it!=end();it++) delete *it; 
+				if (background) XFreePixmap(display,background);
+			}
+			void SetCount(const int n) { if ((n>=2) && (n<=3)) count=n; }
+			void operator()(const int screen,Display* _display,Window& _window,GC& _gc,XImage* image,const int ScreenWidth,const int ScreenHeight)
 			{
-				first=new Buffer(screen,display,window,gc,canvas,image,ScreenWidth,ScreenHeight); 
-				second=new Buffer(screen,display,window,gc,canvas,image,ScreenWidth,ScreenHeight); 
+				display=_display; window=_window; gc=&_gc;
+				for (int i=0;i<count;i++)
+					push_back(new Buffer(screen,display,window,*gc,canvas,ScreenWidth,ScreenHeight)); 
+				if (!image) return;
+				background=XCreatePixmap(display,window,ScreenWidth,ScreenHeight,DefaultDepth(display,DefaultScreen(display)));
+				const int w(image->width), h(image->height);
+				for (int x=0;x<ScreenWidth;x+=w)
+					for (int y=0;y<ScreenHeight;y+=h) 
+						XPutImage(display,background,*gc,image,0,0,x,y,w,h);
+				for (iterator it=begin();it!=end();it++)
+					XCopyArea(display,background,(*it)->bitmap,*gc,0,0,ScreenWidth,ScreenHeight,0,0);
 			}
 			operator Buffer& ()
 			{
-				toggle!=toggle; 
-				return ((toggle)?*first:*second);
+				back=at(current);
+				current=(current+1)%size();
+				if (front) (*back)(front->bitmap,back->stale);
+				back->stale.clear();
+				restored.clear();
+				if (background) 
+				{
+					restored=presented;
+					(*back)(background,restored);
+					for (vector<XRectangle>::iterator it=restored.begin();it!=restored.end();it++)
+						canvas.expose(it->x,it->y,it->width,it->height);
+				}
+				return *back;
+			}
+			void Present(InvalidBase& invalid)
+			{
+				if (!back) return;
+				presented.clear();
+				invalid.Collect(presented);
+				for (vector<XRectangle>::iterator it=restored.begin();it!=restored.end();it++)
+					XCopyArea(display,back->bitmap,window,*gc,it->x,it->y,it->width,it->height,it->x,it->y);
+				for (iterator it=begin();it!=end();it++)
+				{
+					if (*it==back) continue;
+					(*it)->stale.insert((*it)->stale.end(),presented.begin(),presented.end());
+					(*it)->stale.insert((*it)->stale.end(),restored.begin(),restored.end());
+				}
+				front=back;
 			}
-			private: Canvas& canvas;
+			private: 
+			Canvas& canvas;
+			int count,current;
+			Buffer *back,*front;
+			Display* display;
+			GC* gc;
+			Window window;
+			Pixmap background;
+			vector<XRectangle> presented,restored;
 		} ; 
 		protected: ScreenBuffers buffers;
 	};
 	inline ostream& operator<<(ostream& o,Application& a){return a.operator<<(o);} 
+
+	class Headless : public ApplicationBase
+	{
+		public:
+		Headless(Canvas& _canvas,FrameBuffer& _framebuffer) : canvas(_canvas),framebuffer(_framebuffer),bitmap(0),frames(100),raw(false),pool(NULL)
+			{ canvas.framebuffer=&framebuffer; }
+		virtual ~Headless() 
+		{ 
+			canvas.framebuffer=NULL; 
+			canvas.pool=NULL; if (pool) delete pool;
+		}
+		void SetThreads(const int n)
+		{
+			canvas.pool=NULL; 
+			if (pool) delete pool;
+			pool=(n>1)?new Pool(n):NULL;
+			canvas.pool=pool;
+		}
+		void SetFrames(const int n) { if (n>0) frames=n; }
+		void SetDump(const string& _prefix,const bool _raw) { prefix=_prefix; raw=_raw; }
+		virtual void operator()(int argc,char** argv)
+		{
+			for (int frame=0;frame<frames;frame++)
+			{
+				canvas(*this,argc,argv);
+				canvas.update();
+				canvas(bitmap);
+				InvalidBase& invalid(canvas);
+				invalid.reduce();
+				invalid.clear();
+				if (prefix.empty()) continue;
+				stringstream name; name<<prefix<<setfill('0')<<setw(5)<<frame<<(raw?".raw":".ppm");
+				ofstream out(name.str().c_str(),ios::binary);
+				framebuffer.Dump(out,raw);
+			}
+		}
+		private:
+		Canvas& canvas;
+		FrameBuffer& framebuffer;
+		Pixmap bitmap;
+		int frames;
+		string prefix;
+		bool raw;
+		Pool* pool;
+	};
+
 	struct Program : Application
 	{
 		Program(const int screen,Display* display,Window& window,GC& gc,XImage* image,Canvas& canvas,KeyMap& keys,const int ScreenWidth,const int ScreenHeight)
@@ -405,60 +1045,58 @@ namespace X11Methods
 		virtual bool events(Pixmap& bitmap,KeyMap& keys) 
 		{ 
 			XEvent& e(keys);
-			//if (e.type&KeyPress) 
-
-cout<<"k,"<<e.xkey.keycode<<","<<e.xkey.state<<". ";
-
-			cout.flush();
+			X11TraceDebug("key",e.xkey.keycode,e.xkey.state);
 			bool r(canvas(keys));
 			Application::events(bitmap,keys);
 			return r;
 		}
 	};
 
-	inline void DebugEvent( XEvent& e )
+	inline const char* EventName(const int type)
 	{
-		switch ( e.type )
+		switch ( type )
 		{ 
-			case KeyPress: cout << "KeyPress" << endl; break;
-			case KeyRelease: cout << "KeyRelease" << endl; break;
-			case ButtonPress: cout << "ButtonPress" << endl; break;
-			case ButtonRelease: cout << "ButtonRelease" << endl; break;
-			case MotionNotify: cout << "MotionNotify" << endl; break;
-			case EnterNotify: cout << "EnterNotify" << endl; break;
-			case LeaveNotify: cout << "LeaveNotify" << endl; break;
-			case FocusIn: cout << "FocusIn" << endl; break;
-			case FocusOut: cout << "FocusOut" << endl; break;
-			case KeymapNotify: cout << "KeymapNotify" << endl; break;
-			case Expose: cout << "Expose" << endl; break;
-			case GraphicsExpose: cout << "GraphicsExpose" << endl; break;
-			case NoExpose: break; //cout << "NoExpose" << endl; break;
-			case VisibilityNotify: cout << "VisibilityNotify" << endl; break;
-			case CreateNotify: cout << "CreateNotify" << endl; break;
-			case DestroyNotify: cout << "DestroyNotify" << endl; break;
-			case UnmapNotify: cout << "UnmapNotify" << endl; break;
-			case MapNotify: cout << "MapNotify" << endl; break;
-			case MapRequest: cout << "MapRequest" << endl; break;
-			case ReparentNotify: cout << "ReparentNotify" << endl; break;
-			case ConfigureNotify: cout << "ConfigureNotify" << endl; break;
-			case ConfigureRequest: cout << "ConfigureRequest" << endl; break;
-			case GravityNotify: cout << "GravityNotify" << endl; break;
-			case ResizeRequest: cout << "ResizeRequest" << endl; break;
-			case CirculateNotify: cout << "CirculateNotify" << endl; break;
-			case CirculateRequest: cout << "CirculateRequest" << endl; break;
-			case PropertyNotify: cout << "PropertyNotify" << endl; break;
-			case SelectionClear: cout << "SelectionClear" << endl; break;
-			case SelectionRequest: cout << "SelectionRequest" << endl; break;
-			case SelectionNotify: cout << "SelectionNotify" << endl; break;
-			case ColormapNotify: cout << "ColormapNotify" << endl; break;
-			case ClientMessage: cout << "ClientMessage" << endl; break;
-			case MappingNotify: cout << "MappingNotify" << endl; break;
-			case GenericEvent: cout << "GenericEvent" << endl; break;
-			case LASTEvent: cout << "LASTEvent" << endl; break;
-		}
-		cout.flush();
-
-	}	
+			case KeyPress: return "KeyPress";
+			case KeyRelease: return "KeyRelease";
+			case ButtonPress: return "ButtonPress";
+			case ButtonRelease: return "ButtonRelease";
+			case MotionNotify: return "MotionNotify";
+			case EnterNotify: return "EnterNotify";
+			case LeaveNotify: return "LeaveNotify";
+			case FocusIn: return "FocusIn";
+			case FocusOut: return "FocusOut";
+			case KeymapNotify: return "KeymapNotify";
+			case Expose: return "Expose";
+			case GraphicsExpose: return "GraphicsExpose";
+			case NoExpose: return "NoExpose";
+			case VisibilityNotify: return "VisibilityNotify";
+			case CreateNotify: return "CreateNotify";
+			case DestroyNotify: return "DestroyNotify";
+			case UnmapNotify: return "UnmapNotify";
+			case MapNotify: return "MapNotify";
+			case MapRequest: return "MapRequest";
+			case ReparentNotify: return "ReparentNotify";
+			case ConfigureNotify: return "ConfigureNotify";
+			case ConfigureRequest: return "ConfigureRequest";
+			case GravityNotify: return "GravityNotify";
+			case ResizeRequest: return "ResizeRequest";
+			case CirculateNotify: return "CirculateNotify";
+			case CirculateRequest: return "CirculateRequest";
+			case PropertyNotify: return "PropertyNotify";
+			case SelectionClear: return "SelectionClear";
+			case SelectionRequest: return "SelectionRequest";
+			case SelectionNotify: return "SelectionNotify";
+			case ColormapNotify: return "ColormapNotify";
+			case ClientMessage: return "ClientMessage";
+			case MappingNotify: return "MappingNotify";
+			case GenericEvent: return "GenericEvent";
+			case LASTEvent: return "LASTEvent";
+		}
+		return "Unknown";
+	}
+
+	inline void DebugEvent( XEvent& e )
+		{ if (e.type!=NoExpose) X11TraceDebug(EventName(e.type),e.type,e.xany.window); }
 } //X11Methods
 #endif //__X11_METHODS_H__
 
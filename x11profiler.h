@@ -0,0 +1,158 @@
+/*
+* Copyright (c) Jack M. Thompson WebKruncher.com, exexml.com
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the WebKruncher nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY Jack M. Thompson ``AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Jack M. Thompson BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef __X11_PROFILER_H__
+#define __X11_PROFILER_H__
+
+namespace X11Methods
+{
+	using namespace std;
+
+	struct Histogram
+	{
+		// eight linear steps per power of two, so a percentile is within 1/8 of the sample
+		enum {Bits=3,Steps=(1<<Bits),Buckets=(Steps*(65-Bits))};
+		Histogram() : count(0),peak(0) { for (int b=0;b<Buckets;b++) counts[b]=0; }
+		void operator()(const long long ns)
+		{
+			const unsigned long long v((ns>0)?ns:0);
+			__sync_fetch_and_add(&counts[bucket(v)],1);
+			__sync_fetch_and_add(&count,1);
+			unsigned long long seen(peak);
+			while ((v>seen) && (!__sync_bool_compare_and_swap(&peak,seen,v))) seen=peak;
+		}
+		unsigned long long operator[](const double percentile) const
+		{
+			const unsigned long long n(count);
+			if (!n) return 0;
+			const unsigned long long rank((unsigned long long)((n*percentile)/100)+1);
+			unsigned long long seen(0);
+			for (int b=0;b<Buckets;b++)
+			{
+				seen+=counts[b];
+				if (seen>=rank) return min(upper(b),(unsigned long long)peak);
+			}
+			return peak;
+		}
+		unsigned long long Count() const { return count; }
+		unsigned long long Max() const { return peak; }
+		void clear()
+		{
+			for (int b=0;b<Buckets;b++) __sync_lock_test_and_set(&counts[b],0);
+			__sync_lock_test_and_set(&count,0);
+			__sync_lock_test_and_set(&peak,0);
+		}
+		private:
+		static int bucket(const unsigned long long v)
+		{
+			if (v<Steps) return v;
+			const int octave(63-__builtin_clzll(v));
+			return ((octave-Bits+1)<<Bits)|((v>>(octave-Bits))&(Steps-1));
+		}
+		static unsigned long long upper(const int b)
+		{
+			if (b<Steps) return b;
+			const int shift((b>>Bits)-1);
+			return ((((unsigned long long)(Steps|(b&(Steps-1))))+1)<<shift)-1;
+		}
+		volatile unsigned long long counts[Buckets];
+		volatile unsigned long long count,peak;
+	};
+
+	class Profiler
+	{
+		public:
+		enum Phase {Events,Update,Cover,Rows,Draw,Flush,Phases};
+		enum {HudX=10,HudY=10,HudWidth=300,HudLine=14,HudFrames=100};
+		Profiler() : frames(0),live(0) {}
+		static const char* Name(const int phase)
+		{
+			static const char* names[Phases]={"events","update","cover","rows","draw","flush"};
+			return names[phase];
+		}
+		static long long Now()
+		{
+			struct timespec tp;
+			clock_gettime(CLOCK_MONOTONIC,&tp);
+			return (tp.tv_sec*1000000000LL)+tp.tv_nsec;
+		}
+		void operator()(const int phase,const long long ns) { logged[phase](ns); hud[live][phase](ns); }
+		unsigned long long operator++() 
+		{ 
+			const unsigned long long n(__sync_add_and_fetch(&frames,1)); 
+			if (!(n%HudFrames)) 
+			{ 
+				const int next(live^1);
+				for (int p=0;p<Phases;p++) hud[next][p].clear();
+				live=next;
+			}
+			return n;
+		}
+		void Dump(ostream& o)
+		{
+			o<<"frame="<<frames;
+			for (int p=0;p<Phases;p++)
+			{
+				Histogram& h(logged[p]);
+				o<<" "<<Name(p)<<".count="<<h.Count()<<" "<<Name(p)<<".p50="<<h[50]<<" "<<Name(p)<<".p99="<<h[99]<<" "<<Name(p)<<".max="<<h.Max();
+				h.clear();
+			}
+			o<<endl;
+		}
+		int HudHeight() const { return HudLine*(Phases+1)+4; }
+		void operator()(Backend& backend)
+		{
+			XRectangle r; r.x=HudX; r.y=HudY; r.width=HudWidth; r.height=HudHeight();
+			backend.Fill(0X000000,&r,1);
+			backend.Text(0X00FF00,HudX+4,HudY+HudLine,"phase       p50us     p99us     maxus");
+			// the last complete window, so the overlay holds still between updates
+			Histogram* shown(hud[(frames<HudFrames)?live:(live^1)]);
+			for (int p=0;p<Phases;p++)
+			{
+				Histogram& h(shown[p]);
+				stringstream ss; 
+				ss<<left<<setw(8)<<Name(p)<<right<<setw(10)<<(h[50]/1000)<<setw(10)<<(h[99]/1000)<<setw(10)<<(h.Max()/1000);
+				backend.Text(0X00FF00,HudX+4,HudY+(HudLine*(p+2)),ss.str());
+			}
+		}
+		private:
+		Histogram logged[Phases],hud[2][Phases];
+		volatile unsigned long long frames;
+		volatile int live;
+	};
+
+	struct Profile
+	{
+		Profile(Profiler* _profiler,const Profiler::Phase _phase) 
+			: profiler(_profiler),phase(_phase),start(_profiler?Profiler::Now():0) {}
+		~Profile() { if (profiler) (*profiler)(phase,Profiler::Now()-start); }
+		private:
+		Profiler* profiler;
+		const Profiler::Phase phase;
+		const long long start;
+	};
+} //X11Methods
+#endif //__X11_PROFILER_H__
@@ -0,0 +1,163 @@
+/*
+* Copyright (c) Jack M. Thompson WebKruncher.com, exexml.com
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the WebKruncher nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY Jack M. Thompson ``AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Jack M. Thompson BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef __X11_TEXT_H__
+#define __X11_TEXT_H__
+#include <list>
+
+namespace X11Methods
+{
+	using namespace std;
+
+	struct LabelKey
+	{
+		LabelKey(const string& _text,const unsigned long _fg,const unsigned long _bg) : text(_text),fg(_fg),bg(_bg) {}
+		bool operator<(const LabelKey& k) const
+		{
+			if (fg!=k.fg) return fg<k.fg;
+			if (bg!=k.bg) return bg<k.bg;
+			return text<k.text;
+		}
+		string text;
+		unsigned long fg,bg;
+	};
+
+	template <typename Surface>
+		struct TextCache
+	{
+		TextCache(const size_t _capacity=(4<<20)) : capacity(_capacity),bytes(0),hits(0),misses(0) {}
+		virtual ~TextCache() { clear(); }
+		Surface* operator()(const LabelKey& key)
+		{
+			typename Entries::iterator found(entries.find(key));
+			if (found==entries.end()) { misses++; return NULL; }
+			hits++;
+			recent.splice(recent.begin(),recent,found->second.second);
+			return found->second.first;
+		}
+		Surface& insert(const LabelKey& key,Surface* surface)
+		{
+			recent.push_front(key);
+			entries.insert(make_pair(key,make_pair(surface,recent.begin())));
+			bytes+=surface->Bytes();
+			while ((bytes>capacity) && (recent.size()>1)) evict();
+			return *surface;
+		}
+		void SetCapacity(const size_t n) { capacity=n; while ((bytes>capacity) && (!recent.empty())) evict(); }
+		void clear() { while (!recent.empty()) evict(); }
+		size_t Bytes() const { return bytes; }
+		size_t Count() const { return entries.size(); }
+		unsigned long long Hits() const { return hits; }
+		unsigned long long Misses() const { return misses; }
+		private:
+		typedef list<LabelKey> Recent;
+		typedef map<LabelKey,pair<Surface*,typename Recent::iterator> > Entries;
+		size_t capacity,bytes;
+		unsigned long long hits,misses;
+		Recent recent;
+		Entries entries;
+		void evict()
+		{
+			typename Entries::iterator found(entries.find(recent.back()));
+			bytes-=found->second.first->Bytes();
+			delete found->second.first;
+			entries.erase(found);
+			recent.pop_back();
+		}
+		TextCache(const TextCache&);
+		void operator=(const TextCache&);
+	};
+
+	struct RasterLabel : FrameBuffer
+	{
+		enum {Advance=6,Ascent=10,Descent=3};
+		RasterLabel(const LabelKey& key) : FrameBuffer(max(1,static_cast<int>(key.text.size())*Advance),Ascent+Descent)
+		{
+			Raster::Fill(key.bg,0,0,Width(),Height());
+			Text(key.fg,0,Ascent,key.text);
+		}
+		size_t Bytes() const { return Width()*Height()*sizeof(unsigned int); }
+	};
+
+	struct RasterLabels : TextCache<RasterLabel>
+	{
+		void operator()(Backend& target,const LabelKey& key,const int x,const int y)
+		{
+			RasterLabel* label(TextCache<RasterLabel>::operator()(key));
+			if (!label) label=&insert(key,new RasterLabel(key));
+			target.Copy(*label,0,0,label->Width(),label->Height(),x,y-RasterLabel::Ascent);
+		}
+	};
+
+	struct PixmapLabel
+	{
+		PixmapLabel(Display* _display,Drawable drawable,GC& gc,const XFontStruct& font,const LabelKey& key) 
+			: display(_display),width(max(1,XTextWidth(const_cast<XFontStruct*>(&font),key.text.c_str(),key.text.size()))),
+				height(font.ascent+font.descent),ascent(font.ascent),
+				pixmap(XCreatePixmap(display,drawable,width,height,DefaultDepth(display,DefaultScreen(display))))
+		{
+			XSetForeground(display,gc,key.bg);
+			XFillRectangle(display,pixmap,gc,0,0,width,height);
+			XSetForeground(display,gc,key.fg);
+			XDrawString(display,pixmap,gc,0,ascent,key.text.c_str(),key.text.size());
+		}
+		~PixmapLabel() { XFreePixmap(display,pixmap); }
+		size_t Bytes() const { return width*height*sizeof(unsigned int); }
+		void operator()(Drawable target,GC& gc,const int x,const int y) 
+			{ XCopyArea(display,pixmap,target,gc,0,0,width,height,x,y-ascent); }
+		private:
+		Display* display;
+		const int width,height,ascent;
+		Pixmap pixmap;
+		PixmapLabel(const PixmapLabel&);
+		void operator=(const PixmapLabel&);
+	};
+
+	struct PixmapLabels : TextCache<PixmapLabel>
+	{
+		PixmapLabels() : font(NULL) {}
+		virtual ~PixmapLabels() { clear(); if (font) XFreeFontInfo(NULL,font,1); }
+		void operator()(Display* display,Drawable target,GC& gc,const LabelKey& key,const int x,const int y)
+		{
+			PixmapLabel* label(TextCache<PixmapLabel>::operator()(key));
+			if (!label)
+			{
+				if (!font) font=XQueryFont(display,XGContextFromGC(gc));
+				if (!font) 
+				{
+					XSetForeground(display,gc,key.fg);
+					XDrawString(display,target,gc,x,y,key.text.c_str(),key.text.size());
+					return;
+				}
+				label=&insert(key,new PixmapLabel(display,target,gc,*font,key));
+			}
+			(*label)(target,gc,x,y);
+		}
+		private:
+		XFontStruct* font;
+	};
+} //X11Methods
+#endif //__X11_TEXT_H__
@@ -0,0 +1,212 @@
+/*
+* Copyright (c) Jack M. Thompson WebKruncher.com, exexml.com
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the WebKruncher nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY Jack M. Thompson ``AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Jack M. Thompson BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef __X11_THREADS_H__
+#define __X11_THREADS_H__
+#include <pthread.h>
+
+namespace X11Methods
+{
+	using namespace std;
+
+	struct Job
+	{
+		virtual ~Job() {}
+		virtual void operator()(const int i) = 0;
+	};
+
+	struct SpinLock
+	{
+		SpinLock() : locked(0) {}
+		void lock() { while (__sync_lock_test_and_set(&locked,1)) while (locked) ; }
+		void unlock() { __sync_lock_release(&locked); }
+		private:
+		volatile int locked;
+	};
+
+	struct Guard
+	{
+		Guard(SpinLock& _spin) : spin(_spin) { spin.lock(); }
+		~Guard() { spin.unlock(); }
+		private:
+		SpinLock& spin;
+	};
+
+	template <typename T,int Bits>
+		class Ring
+	{
+		public:
+		enum {Size=(1<<Bits),Mask=(Size-1)};
+		Ring() : head(0),tail(0) {}
+		bool push(const T& item)
+		{
+			const unsigned long h(head);
+			if (h-tail>=Size) return false;
+			items[h&Mask]=item;
+			__sync_synchronize();
+			head=h+1;
+			return true;
+		}
+		bool pop(T& item)
+		{
+			const unsigned long t(tail);
+			if (t==head) return false;
+			__sync_synchronize();
+			item=items[t&Mask];
+			__sync_synchronize();
+			tail=t+1;
+			return true;
+		}
+		bool empty() const { return head==tail; }
+		private:
+		T items[Size];
+		volatile unsigned long head,tail;
+	};
+
+	class Pool
+	{
+		public:
+		Pool(const int threads) : count((threads>1)?threads:1),queues(new Queue[count]),generation(0),pending(0),stopping(false),job(NULL)
+		{
+			pthread_mutex_init(&mutex,NULL);
+			pthread_cond_init(&wake,NULL);
+			pthread_cond_init(&done,NULL);
+			for (int k=1;k<count;k++)
+			{
+				pthread_t thread;
+				if (pthread_create(&thread,NULL,working,new Worker(*this,k))) throw runtime_error("Cannot create worker thread");
+				workers.push_back(thread);
+			}
+		}
+		virtual ~Pool()
+		{
+			pthread_mutex_lock(&mutex);
+			stopping=true;
+			pthread_cond_broadcast(&wake);
+			pthread_mutex_unlock(&mutex);
+			for (vector<pthread_t>::iterator it=workers.begin();it!=workers.end();it++) pthread_join(*it,NULL);
+			pthread_cond_destroy(&done);
+			pthread_cond_destroy(&wake);
+			pthread_mutex_destroy(&mutex);
+			delete[] queues;
+		}
+		int Threads() const { return count; }
+		void operator()(Job& _job,const int n)
+		{
+			if (n<=0) return;
+			job=&_job;
+			pending=n;
+			for (int k=0;k<count;k++)
+			{
+				Guard guard(queues[k].spin);
+				queues[k].front=(int)(((long long)n*k)/count);
+				queues[k].back=(int)(((long long)n*(k+1))/count);
+			}
+			pthread_mutex_lock(&mutex);
+			generation++;
+			pthread_cond_broadcast(&wake);
+			pthread_mutex_unlock(&mutex);
+			run(0);
+			pthread_mutex_lock(&mutex);
+			while (pending) pthread_cond_wait(&done,&mutex);
+			pthread_mutex_unlock(&mutex);
+		}
+		private:
+		struct Queue 
+		{ 
+			Queue() : front(0),back(0) {}
+			SpinLock spin;
+			int front,back;
+		};
+		struct Worker
+		{
+			Worker(Pool& _pool,const int _k) : pool(_pool),k(_k) {}
+			Pool& pool;
+			const int k;
+		};
+		const int count;
+		Queue* queues;
+		vector<pthread_t> workers;
+		pthread_mutex_t mutex;
+		pthread_cond_t wake,done;
+		unsigned long long generation;
+		volatile int pending;
+		bool stopping;
+		Job* volatile job;
+		bool take(const int k,int& i)
+		{
+			Guard guard(queues[k].spin);
+			if (queues[k].front>=queues[k].back) return false;
+			i=--queues[k].back;
+			return true;
+		}
+		bool steal(const int k,int& i)
+		{
+			for (int v=1;v<count;v++)
+			{
+				Queue& victim(queues[(k+v)%count]);
+				Guard guard(victim.spin);
+				if (victim.front>=victim.back) continue;
+				i=victim.front++;
+				return true;
+			}
+			return false;
+		}
+		void run(const int k)
+		{
+			int i;
+			while ((take(k,i)) || (steal(k,i)))
+			{
+				(*job)(i);
+				if (__sync_sub_and_fetch(&pending,1)) continue;
+				pthread_mutex_lock(&mutex);
+				pthread_cond_signal(&done);
+				pthread_mutex_unlock(&mutex);
+			}
+		}
+		static void* working(void* p)
+		{
+			Worker* worker(static_cast<Worker*>(p));
+			Pool& pool(worker->pool);
+			const int k(worker->k);
+			delete worker;
+			unsigned long long seen(0);
+			while (true)
+			{
+				pthread_mutex_lock(&pool.mutex);
+				while ((!pool.stopping) && (pool.generation==seen)) pthread_cond_wait(&pool.wake,&pool.mutex);
+				seen=pool.generation;
+				const bool stopping(pool.stopping);
+				pthread_mutex_unlock(&pool.mutex);
+				if (stopping) return NULL;
+				pool.run(k);
+			}
+		}
+		Pool(const Pool&);
+		void operator=(const Pool&);
+	};
+} //X11Methods
+#endif //__X11_THREADS_H__
@@ -0,0 +1,167 @@
+/*
+* Copyright (c) Jack M. Thompson WebKruncher.com, exexml.com
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the WebKruncher nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY Jack M. Thompson ``AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Jack M. Thompson BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef __X11_TRACE_H__
+#define __X11_TRACE_H__
+
+#ifndef X11TRACE
+#define X11TRACE 0
+#endif
+
+#if X11TRACE
+#include <pthread.h>
+#endif
+
+namespace X11Methods
+{
+	using namespace std;
+
+	enum TraceLevel {TraceOff=0,TraceError=1,TraceInfo=2,TraceDebug=3,TraceVerbose=4};
+
+	struct TraceRecord
+	{
+		long long when;
+		int level;
+		const char* what;
+		long a,b;
+	};
+
+	class Tracer
+	{
+		public:
+		enum {Bits=12,Slots=(1<<Bits),Mask=(Slots-1)};
+		static Tracer& Instance() { static Tracer tracer; return tracer; }
+		void operator()(const int level,const char* what,const long a,const long b)
+		{
+			if (!running) start();
+			unsigned long long position(head);
+			while (true)
+			{
+				Slot& slot(slots[position&Mask]);
+				const long long difference((long long)slot.sequence-(long long)position);
+				if (!difference)
+				{
+					if (__sync_bool_compare_and_swap(&head,position,position+1)) 
+					{
+						struct timespec tp;
+						clock_gettime(CLOCK_MONOTONIC,&tp);
+						slot.record.when=(tp.tv_sec*1000000000LL)+tp.tv_nsec;
+						slot.record.level=level; slot.record.what=what;
+						slot.record.a=a; slot.record.b=b;
+						__sync_synchronize();
+						slot.sequence=position+1;
+						return;
+					}
+				} else if (difference<0) { __sync_fetch_and_add(&dropped,1); return; }
+				position=head;
+			}
+		}
+		void operator()(ostream& o)
+		{
+			while (true)
+			{
+				Slot& slot(slots[tail&Mask]);
+				if (slot.sequence!=tail+1) break;
+				__sync_synchronize();
+				const TraceRecord& r(slot.record);
+				o<<r.when<<" "<<r.level<<" "<<r.what<<" "<<r.a<<" "<<r.b<<"\n";
+				__sync_synchronize();
+				slot.sequence=tail+Slots;
+				tail++;
+			}
+			const unsigned long long lost(__sync_lock_test_and_set(&dropped,0));
+			if (lost) o<<"dropped "<<lost<<"\n";
+			o.flush();
+		}
+		private:
+		struct Slot 
+		{ 
+			volatile unsigned long long sequence; 
+			TraceRecord record; 
+		};
+		Slot slots[Slots];
+		volatile unsigned long long head;
+		unsigned long long tail;
+		volatile unsigned long long dropped;
+		volatile bool running,stopping;
+#if X11TRACE
+		pthread_t drain;
+		pthread_mutex_t starting;
+		Tracer() : head(0),tail(0),dropped(0),running(false),stopping(false)
+		{
+			for (unsigned long long i=0;i<Slots;i++) slots[i].sequence=i;
+			pthread_mutex_init(&starting,NULL);
+		}
+		~Tracer()
+		{
+			if (running) { stopping=true; pthread_join(drain,NULL); }
+			(*this)(cerr);
+			pthread_mutex_destroy(&starting);
+		}
+		void start()
+		{
+			pthread_mutex_lock(&starting);
+			if (!running) running=!pthread_create(&drain,NULL,draining,this);
+			pthread_mutex_unlock(&starting);
+		}
+		static void* draining(void* p)
+		{
+			Tracer& tracer(*static_cast<Tracer*>(p));
+			while (!tracer.stopping) { tracer(cerr); usleep(10000); }
+			return NULL;
+		}
+#else
+		Tracer() : head(0),tail(0),dropped(0),running(true),stopping(false) 
+			{ for (unsigned long long i=0;i<Slots;i++) slots[i].sequence=i; }
+		void start() {}
+#endif
+		Tracer(const Tracer&);
+		void operator=(const Tracer&);
+	};
+} //X11Methods
+
+#if X11TRACE>=1
+#define X11TraceError(what,a,b) X11Methods::Tracer::Instance()(X11Methods::TraceError,(what),(a),(b))
+#else
+#define X11TraceError(what,a,b) ((void)sizeof((what),(a),(b)))
+#endif
+#if X11TRACE>=2
+#define X11TraceInfo(what,a,b) X11Methods::Tracer::Instance()(X11Methods::TraceInfo,(what),(a),(b))
+#else
+#define X11TraceInfo(what,a,b) ((void)sizeof((what),(a),(b)))
+#endif
+#if X11TRACE>=3
+#define X11TraceDebug(what,a,b) X11Methods::Tracer::Instance()(X11Methods::TraceDebug,(what),(a),(b))
+#else
+#define X11TraceDebug(what,a,b) ((void)sizeof((what),(a),(b)))
+#endif
+#if X11TRACE>=4
+#define X11TraceVerbose(what,a,b) X11Methods::Tracer::Instance()(X11Methods::TraceVerbose,(what),(a),(b))
+#else
+#define X11TraceVerbose(what,a,b) ((void)sizeof((what),(a),(b)))
+#endif
+
+#endif //__X11_TRACE_H__
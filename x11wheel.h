@@ -0,0 +1,94 @@
+/*
+* Copyright (c) Jack M. Thompson WebKruncher.com, exexml.com
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the WebKruncher nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY Jack M. Thompson ``AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Jack M. Thompson BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef __X11_WHEEL_H__
+#define __X11_WHEEL_H__
+
+namespace X11Methods
+{
+	using namespace std;
+
+	struct TimedExpiry { enum {Timed=1}; };
+	struct ScannedExpiry { enum {Timed=0}; };
+
+	template <typename T>
+		struct TimingWheel
+	{
+		enum {Bits=6,Slots=(1<<Bits),Mask=(Slots-1),Levels=4};
+		TimingWheel() : now(0),count(0) {}
+		unsigned long long Now() const { return now; }
+		size_t size() const { return count; }
+		void operator()(unsigned long long when,const T& item)
+		{
+			if (when<=now) when=now+1;
+			count++;
+			place(Entry(when,item));
+		}
+		void operator()(const unsigned long long to,vector<T>& due)
+		{
+			while ((count) && (now<to))
+			{
+				now++;
+				if (!(now&Mask)) cascade(1);
+				vector<Entry>& slot(slots[0][now&Mask]);
+				for (typename vector<Entry>::iterator it=slot.begin();it!=slot.end();it++) due.push_back(it->item);
+				count-=slot.size();
+				slot.clear();
+			}
+			if (now<to) now=to;
+		}
+		private:
+		struct Entry
+		{
+			Entry(const unsigned long long _when,const T& _item) : when(_when),item(_item) {}
+			unsigned long long when;
+			T item;
+		};
+		vector<Entry> slots[Levels][Slots];
+		vector<Entry> overflow;
+		unsigned long long now;
+		size_t count;
+		void place(const Entry& e)
+		{
+			for (int level=0;level<Levels;level++)
+				if ((e.when>>(Bits*(level+1)))==(now>>(Bits*(level+1))))
+					{ slots[level][(e.when>>(Bits*level))&Mask].push_back(e); return; }
+			overflow.push_back(e);
+		}
+		void cascade(const int level)
+		{
+			vector<Entry> moving;
+			if (level==Levels) moving.swap(overflow);
+			else
+			{
+				if (!((now>>(Bits*level))&Mask)) cascade(level+1);
+				moving.swap(slots[level][(now>>(Bits*level))&Mask]);
+			}
+			for (typename vector<Entry>::iterator it=moving.begin();it!=moving.end();it++) place(*it);
+		}
+	};
+} //X11Methods
+#endif //__X11_WHEEL_H__